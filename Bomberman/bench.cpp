@@ -0,0 +1,339 @@
+// Simulator and GA microbenchmarks: g++ -std=c++17 -O2 -pthread bench.cpp -o bench
+// ./bench [--min-ms=300] [--label=<commit>] prints one JSON object per line
+// ./bench --verify-batch checks the lockstep batch against Board::update, exit status 1 on a mismatch
+#define BOMBERMAN_LIBRARY
+#include "bomberman.cpp"
+
+struct BenchState {
+    const char* name;
+    const char* rows [GLOBAL_MAX_HEIGHT];
+    vector<array<int, 6> > entities;
+};
+
+// Captured positions, entities are "entityType owner x y param1 param2" as in the game input
+const BenchState GLOBAL_BENCH_STATES[] = {
+    {"early", {
+        "..020...020..",
+        ".X2X1X2X1X2X.",
+        "0.00..0..00.0",
+        "0X.X.X.X.X.X0",
+        "00.002.200.00",
+        "0X.X0X1X0X.X0",
+        "00.002.200.00",
+        "0X.X.X.X.X.X0",
+        "0.00..0..00.0",
+        ".X2X1X2X1X2X.",
+        "..020...020.."},
+     {{0, 0, 0, 0, 1, 3}, {0, 1, 12, 10, 1, 3}, {0, 2, 12, 0, 1, 3}, {0, 3, 0, 10, 1, 3}}},
+    {"mid_chain", {
+        "..2..202..2..",
+        ".X0X0X0X0X0X.",
+        ".2.........2.",
+        ".X.X.X.X.X.X.",
+        ".1.......0.1.",
+        "0X1X.X.X.X1X0",
+        ".1.0.....0.1.",
+        ".X.X.X.X.X.X.",
+        ".2......1..2.",
+        ".X0X0X0X0X0X.",
+        "..2..202..2.."},
+     {{0, 0, 0, 0, 1, 3}, {0, 1, 10, 2, 0, 4}, {0, 2, 6, 6, 2, 3}, {0, 3, 7, 8, 1, 3},
+      {1, 0, 4, 2, 3, 3}, {1, 0, 6, 2, 5, 3}, {1, 1, 8, 2, 7, 4}, {1, 1, 4, 4, 2, 4},
+      {1, 2, 6, 4, 6, 3}, {1, 2, 8, 4, 4, 3}, {1, 3, 4, 6, 1, 4}, {1, 2, 8, 6, 3, 3},
+      {1, 3, 6, 8, 8, 3}, {1, 0, 2, 8, 5, 2}, {1, 1, 10, 8, 6, 3}, {1, 3, 0, 6, 4, 3},
+      {2, 0, 12, 4, 1, 0}, {2, 0, 0, 2, 2, 0}}},
+    {"sparse_end", {
+        ".............",
+        ".X.X2X.X2X.X.",
+        ".............",
+        ".X.X.X.X.X.X.",
+        "..0.......0..",
+        ".X.X.X.X.X.X.",
+        "..0.......0..",
+        ".X.X.X.X.X.X.",
+        ".............",
+        ".X.X2X.X2X.X.",
+        "............."},
+     {{0, 0, 3, 4, 2, 5}, {0, 2, 9, 6, 3, 4},
+      {1, 0, 2, 2, 4, 5}, {1, 2, 10, 8, 6, 4},
+      {2, 0, 5, 0, 1, 0}, {2, 0, 6, 10, 2, 0}}},
+};
+
+inline Board loadState(const BenchState& state) {
+    Bot bot(0);
+    bot.beginTurn();
+    for (int y = 0; y < GLOBAL_MAX_HEIGHT; ++y) {
+        bot.readRow(y, state.rows[y]);
+    }
+    bot.beginEntities();
+    for (const array<int, 6>& e : state.entities) {
+        bot.readEntity(e[0], e[1], e[2], e[3], e[4], e[5]);
+    }
+    bot.theBoard.countPlayers();
+    return bot.theBoard;
+}
+
+// Scores of random genomes from every state and every player, Board::update against BatchSim
+inline bool verifyBatch() {
+    if (!global_batch_supported) {
+        cout << "{\"bench\":\"verify_batch\",\"skipped\":\"no AVX2\"}" << endl;
+        return true;
+    }
+    bool ok = true;
+    for (const BenchState& state : GLOBAL_BENCH_STATES) {
+        const Board root = loadState(state);
+        Rng rng(7);
+        Timer timer(INT_MAX);
+        long rollouts = 0;
+        long mismatches = 0;
+        for (int id = 0; id < root.playerNum; ++id) {
+            if (!root.players[id].isAlive) {
+                continue;
+            }
+            Evolution evol(id, 1, FullGenome(), root, timer, rng);
+            evol.rootBitBoard.load(root);
+            for (int round = 0; round < 10; ++round) {
+                FullGenome expected [GLOBAL_POPULATION_SIZE];
+                for (uint i = 0; i < GLOBAL_POPULATION_SIZE; ++i) {
+                    expected[i] = FullGenome(rng);
+                    evol.population.set(i, expected[i]);
+                    evol.calculateScore(id, expected[i], root);
+                }
+                forPlayerNum(root.playerNum, [&](auto players) {
+                    for (uint i = 0; i < GLOBAL_POPULATION_SIZE; i += GLOBAL_BATCH_LANES) {
+                        evol.calculateScoreBatch<decltype(players)::value>(id, i, min<int>(GLOBAL_BATCH_LANES, GLOBAL_POPULATION_SIZE - i), evol.workers[0]);
+                    }
+                });
+                for (uint i = 0; i < GLOBAL_POPULATION_SIZE; ++i) {
+                    bool same = true;
+                    for (char k = 0; k < root.playerNum; ++k) {
+                        same &= evol.population.scores[k][i] == expected[i].array[k].score;
+                    }
+                    mismatches += !same;
+                    ++rollouts;
+                }
+            }
+        }
+        cout << "{\"state\":\"" << state.name << "\",\"bench\":\"verify_batch\",\"rollouts\":" << rollouts
+             << ",\"mismatches\":" << mismatches << "}" << endl;
+        ok &= mismatches == 0;
+    }
+    return ok;
+}
+
+long global_bench_min_ms = 300;
+volatile long global_bench_sink = 0;
+
+// Nanoseconds per call of f, doubling the batch until it runs long enough
+template <typename F>
+inline double measure(F f, long& calls) {
+    for (calls = 1; ; calls *= 2) {
+        chrono::time_point<chrono::steady_clock> start = chrono::steady_clock::now();
+        for (long i = 0; i < calls; ++i) {
+            f();
+        }
+        double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+        if (ns >= global_bench_min_ms * 1e6) {
+            return ns / calls;
+        }
+    }
+}
+
+string global_bench_label = "";
+
+inline void report(const string& state, const string& bench, double ns, long calls, const string& extra = "") {
+    cout << "{\"label\":\"" << global_bench_label << "\",\"state\":\"" << state << "\",\"bench\":\"" << bench
+         << "\",\"ns_per_op\":" << ns << ",\"ops\":" << calls << extra << "}" << endl;
+}
+
+int main(int argc, char** argv)
+{
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg.compare(0, 9, "--min-ms=") == 0) {
+            global_bench_min_ms = atol(arg.c_str() + 9);
+        } else if (arg.compare(0, 8, "--label=") == 0) {
+            global_bench_label = arg.substr(8);
+        } else if (arg == "--bitboard") {
+            global_config.bitboard = true;
+        } else if (arg == "--undo") {
+            global_config.undo = true;
+        } else if (arg == "--checkpoints") {
+            global_config.checkpoints = true;
+        } else if (arg == "--danger") {
+            global_config.dangerMap = true;
+        } else if (arg == "--batch") {
+            global_config.batch = true;
+        } else if (arg.compare(0, 9, "--config=") == 0) {
+            if (!global_config.load(arg.substr(9))) {
+                return 1;
+            }
+        } else if (arg.compare(0, 8, "--depth=") == 0) {
+            if (!global_config.set("depth", arg.substr(8))) {
+                cerr << "Cannot read " << arg << endl;
+                return 1;
+            }
+        } else if (arg == "--leaf") {
+            global_config.leaf = GLOBAL_LEAF_DISTANCE;
+        } else if (arg == "--verify-batch") {
+            return verifyBatch() ? 0 : 1;
+        } else if (arg == "--tt") {
+            global_config.ttBits = 16;
+        } else if (arg.compare(0, 5, "--tt=") == 0) {
+            if (!global_config.set("ttBits", arg.substr(5))) {
+                cerr << "Cannot read " << arg << endl;
+                return 1;
+            }
+        }
+    }
+    for (const BenchState& state : GLOBAL_BENCH_STATES) {
+        Rng rng(1);
+        const Board root = loadState(state);
+        const int id = 0;
+        long calls;
+        SimScratch scratch;
+        vector<FullGenome> genomes;
+        for (uint i = 0; i < GLOBAL_POPULATION_SIZE; ++i) {
+            genomes.emplace_back(rng);
+        }
+
+        double copy = measure([&] {
+            Board b = root;
+            global_bench_sink += b.scores[0];
+        }, calls);
+        report(state.name, "board_copy", copy, calls);
+
+        // Rollouts from the root, reported per simulated turn
+        long turns = 0;
+        long rollouts = 0;
+        double rollout = measure([&] {
+            Board b = root;
+            const FullGenome& g = genomes[rollouts++ % GLOBAL_POPULATION_SIZE];
+            for (char i = 0; i < GLOBAL_GENOME_SIZE; ++i) {
+                Gene gArray[GLOBAL_PLAYER_NUM];
+                g.genes(i, gArray);
+                b.update(gArray, GLOBAL_GENOME_SIZE-i, scratch);
+                ++turns;
+                if (b.scores[id] == INT_MIN) {
+                    break;
+                }
+            }
+            global_bench_sink += b.scores[id];
+        }, calls);
+        report(state.name, "update", (rollout - copy) * rollouts / turns, turns,
+               ",\"turns_per_rollout\":" + to_string(double(turns) / rollouts));
+
+        double badaboum = measure([&] {
+            Board b = root;
+            scratch.deleteBox.setEmpty();
+            b.bigBadaboum(scratch);
+            global_bench_sink += b.bombNum;
+        }, calls);
+        report(state.name, "bigBadaboum", badaboum, calls, ",\"includes_copy\":true");
+
+        if (root.bombNum > 0) {
+            double process = measure([&] {
+                Board b = root;
+                scratch.explosionList.setEmpty();
+                scratch.deletedObjects.setEmpty();
+                b.processBomb(0, scratch.explosionList, scratch.deletedObjects);
+                global_bench_sink += scratch.deletedObjects.next;
+            }, calls);
+            report(state.name, "processBomb", process, calls, ",\"includes_copy\":true");
+        }
+
+        // Once per turn, and once per rollout reaching the horizon
+        LeafEvaluator* leaf = new LeafEvaluator();
+        SearchConfig config;
+        config.leaf = GLOBAL_LEAF_DISTANCE;
+        double leafBuild = measure([&] {
+            leaf->build(root, config);
+            global_bench_sink += leaf->value[id][0];
+        }, calls);
+        report(state.name, "leaf_build", leafBuild, calls);
+        double leafEvaluate = measure([&] {
+            int scores [GLOBAL_PLAYER_NUM] = {0};
+            forPlayerNum(root.playerNum, [&](auto players) {
+                leaf->evaluate<decltype(players)::value>(root, scores);
+            });
+            global_bench_sink += scores[id];
+        }, calls);
+        report(state.name, "leaf_evaluate", leafEvaluate, calls);
+        delete leaf;
+
+        Timer timer(1000000000);
+        Evolution* evol = new Evolution(id, GLOBAL_POPULATION_SIZE, FullGenome(rng), root, timer, rng);
+        long index = 0;
+        double score = measure([&] {
+            evol->calculateScore(id, genomes[index++ % GLOBAL_POPULATION_SIZE], root);
+        }, calls);
+        report(state.name, "calculateScore", score, calls, ",\"rollouts_per_s\":" + to_string(1e9 / score));
+
+        // Per rollout, GLOBAL_BATCH_LANES at a time
+        if (global_batch_supported) {
+            evol->rootBitBoard.load(root);
+            for (uint i = 0; i < GLOBAL_POPULATION_SIZE; ++i) {
+                evol->population.set(i, genomes[i]);
+            }
+            index = 0;
+            double batch = measure([&] {
+                const uint begin = (index++ * GLOBAL_BATCH_LANES) % (GLOBAL_POPULATION_SIZE - GLOBAL_BATCH_LANES + 1);
+                forPlayerNum(root.playerNum, [&](auto players) {
+                    evol->calculateScoreBatch<decltype(players)::value>(id, begin, GLOBAL_BATCH_LANES, evol->workers[0]);
+                });
+            }, calls) / GLOBAL_BATCH_LANES;
+            report(state.name, "calculateScoreBatch", batch, calls * GLOBAL_BATCH_LANES, ",\"rollouts_per_s\":" + to_string(1e9 / batch));
+        }
+
+        uint probes0, hits0, stores0;
+        evol->ttStats(probes0, hits0, stores0);
+        uint steps0, skipped0;
+        evol->depthStats(steps0, skipped0);
+        const uint compute0 = evol->compute;
+        double generation = measure([&] {
+            evol->evolveOnce(id);
+        }, calls);
+        report(state.name, "evolveOnce", generation, calls,
+               ",\"generations_per_budget\":" + to_string(GLOBAL_TURN_TIME_MAX * 1e6 / generation));
+        uint steps, skipped;
+        evol->depthStats(steps, skipped);
+        const double scored = max(1u, evol->compute - compute0);
+        cout << "{\"label\":\"" << global_bench_label << "\",\"state\":\"" << state.name << "\",\"bench\":\"evolveOnce_depth\",\"steps_per_rollout\":"
+             << (steps - steps0) / scored << ",\"skipped_steps_per_rollout\":" << (skipped - skipped0) / scored << "}" << endl;
+        int dead = 0;
+        for (uint i = 0; i < GLOBAL_POPULATION_SIZE; ++i) {
+            dead += evol->population.scores[id][i] == INT_MIN;
+        }
+        cout << "{\"label\":\"" << global_bench_label << "\",\"state\":\"" << state.name << "\",\"bench\":\"evolveOnce_danger\",\"doomed\":"
+             << evol->doomed << ",\"redrawn\":" << evol->redrawn << ",\"dead_share\":" << double(dead) / GLOBAL_POPULATION_SIZE << "}" << endl;
+        if (global_config.ttBits) {
+            uint probes, hits, stores;
+            evol->ttStats(probes, hits, stores);
+            probes -= probes0;
+            hits -= hits0;
+            stores -= stores0;
+            cout << "{\"label\":\"" << global_bench_label << "\",\"state\":\"" << state.name << "\",\"bench\":\"evolveOnce_tt\",\"probes\":" << probes
+                 << ",\"hits\":" << hits << ",\"stores\":" << stores << ",\"hit_rate\":" << double(hits) / max(1u, probes) << "}" << endl;
+        }
+
+        double best = measure([&] {
+            global_bench_sink += evol->findBestFullGenome(id).array[id].score;
+        }, calls);
+        report(state.name, "findBestFullGenome", best, calls);
+        delete evol;
+
+        // The tree restarts every 8192 iterations, about what a turn of 20 ms explores
+        Smitsimax mcts;
+        long iterations = 0;
+        uint nodes = 0;
+        double iteration = measure([&] {
+            if (iterations++ % 8192 == 0) {
+                mcts.reset(root, timer, rng, global_config.weights);
+            }
+            mcts.iterate(id);
+            nodes = max(nodes, mcts.used);
+        }, calls);
+        report(state.name, "smitsimax_iterate", iteration, calls,
+               ",\"nodes\":" + to_string(nodes) + ",\"steps_per_iteration\":" + to_string(double(mcts.worker.steps) / iterations));
+    }
+}
@@ -13,7 +13,19 @@
 #include <set>
 #include <stdlib.h>
 #include <climits>
+#include <cmath>
 #include <queue>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <type_traits>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <fstream>
 
 using namespace std;
 
@@ -21,24 +33,31 @@ const signed char GLOBAL_TURN_TIME = 100;
 const signed char GLOBAL_TURN_TIME_MAX = 92;
 const int GLOBAL_TURN_TIME_MAX_FIRST_TURN = 450;
 const signed char GLOBAL_GENOME_SIZE = 16;
+static_assert(GLOBAL_GENOME_SIZE * 4 <= 64, "a Genome is packed in one 64 bit word");
+const uint64_t GLOBAL_GENOME_NIBBLE_LOW = 0x1111111111111111ULL >> (64 - 4*GLOBAL_GENOME_SIZE);
 const uint GLOBAL_GENOME_SAMPLE_SIZE = 50000;
 const signed char GLOBAL_MAX_WIDTH = 13;
 const signed char GLOBAL_MAX_HEIGHT = 11;
 bool global_debug = false;
 const signed char GLOBAL_PLAYER_NUM = 4;
-const float GLOBAL_MUTATION_RATE = 0.15;
 const uint GLOBAL_POPULATION_SIZE = 1000;
 const uint GLOBAL_MAX_GENERATION_NUM = 50;
 
-int global_turn = 1;
-    
-uint global_compute = 0;
-uint global_generation = 0;
-struct Board;
-Board* global_board;
+// Calls f(integral_constant<char, P>()) with the player count of the game, so that the
+// loops over players of the simulation unroll for 2, 3 and 4 players
+template <typename F>
+inline void forPlayerNum(char playerNum, F&& f) {
+    switch (playerNum) {
+        case 2: f(integral_constant<char, 2>()); break;
+        case 3: f(integral_constant<char, 3>()); break;
+        default: f(integral_constant<char, GLOBAL_PLAYER_NUM>()); break;
+    }
+}
+
+const uint GLOBAL_TIMER_CHECK_MASK = 7; // amortized checks read the clock every 8 calls
 
 struct Timer{
-    chrono::time_point<chrono::system_clock> end;    
+    chrono::time_point<chrono::steady_clock> end;    
     inline Timer() = default;
     inline Timer(Timer const&) = default;
     inline Timer(Timer&&) = default;
@@ -47,19 +66,65 @@ struct Timer{
 
     inline Timer(bool first_turn=false){
         if (first_turn) {
-            this->end=chrono::system_clock::now()+chrono::milliseconds(GLOBAL_TURN_TIME_MAX_FIRST_TURN);
+            this->end=chrono::steady_clock::now()+chrono::milliseconds(GLOBAL_TURN_TIME_MAX_FIRST_TURN);
         } else {
-            this->end=chrono::system_clock::now()+chrono::milliseconds(GLOBAL_TURN_TIME_MAX);
+            this->end=chrono::steady_clock::now()+chrono::milliseconds(GLOBAL_TURN_TIME_MAX);
         }
     }
+    inline Timer(int milliseconds){
+        this->end=chrono::steady_clock::now()+chrono::milliseconds(milliseconds);
+    }
+    inline Timer(const chrono::time_point<chrono::steady_clock>& end) : end(end) {}
     inline bool isTimesUp(){
-        return std::chrono::system_clock::now() > this->end;
+        return std::chrono::steady_clock::now() > this->end;
+    }
+    // For loops checking before each iteration i, only every GLOBAL_TIMER_CHECK_MASK+1 of them reads the clock
+    inline bool isTimesUp(uint i){
+        return (i & GLOBAL_TIMER_CHECK_MASK) == 0 && this->isTimesUp();
+    }
+};
+
+const double GLOBAL_TIME_MARGIN_MIN = 1.5; // ms left for writing the output and the scheduler
+const double GLOBAL_TIME_MARGIN_MAX = 30;
+const double GLOBAL_TIME_TAIL_WEIGHT = 0.2;
+
+// Clock of a whole turn, started when its first input line arrives. The search
+// stops margin ms before the budget, the margin follows the time spent between
+// the end of the search and the answer on the previous turns.
+struct TimeManager {
+    chrono::time_point<chrono::steady_clock> start = chrono::steady_clock::now();
+    double margin = GLOBAL_TURN_TIME - GLOBAL_TURN_TIME_MAX;
+    double tailMean = 0;
+    double tailVariance = 0;
+    uint samples = 0;
+    bool calibrate = true;
+
+    inline void startTurn() {
+        this->start = chrono::steady_clock::now();
+    }
+    inline Timer timer(int budget) const {
+        return Timer(this->start + chrono::microseconds(long((budget - this->margin) * 1000)));
+    }
+    // Mean plus 3 deviations of the recent tails, searches stopped before the deadline say nothing
+    inline void endTurn(const Timer& timer) {
+        const double tail = chrono::duration<double, milli>(chrono::steady_clock::now() - timer.end).count();
+        if (!this->calibrate || tail < 0) {
+            return;
+        }
+        if (this->samples++ == 0) {
+            this->tailMean = tail;
+        } else {
+            const double delta = tail - this->tailMean;
+            this->tailMean += GLOBAL_TIME_TAIL_WEIGHT * delta;
+            this->tailVariance = (1 - GLOBAL_TIME_TAIL_WEIGHT) * (this->tailVariance + GLOBAL_TIME_TAIL_WEIGHT * delta * delta);
+        }
+        this->margin = min(GLOBAL_TIME_MARGIN_MAX, GLOBAL_TIME_MARGIN_MIN + this->tailMean + 3 * sqrt(this->tailVariance));
     }
 };
-Timer* global_timer = NULL;
 
 struct Point
 {
+    inline Point(Point const&) = default;
     inline Point(Point&&) = default;
     inline Point& operator=(Point const&) = default;
     inline Point& operator=(Point&&) = default;
@@ -69,10 +134,6 @@ struct Point
         this->x = -1;
         this->y = -1;
     }
-    inline Point(const Point& p) {
-        this->x = p.x;
-        this->y = p.y;
-    }
     inline Point(char x1,char y1) : x(x1), y(y1) {
     }
     inline string toString() const
@@ -91,15 +152,18 @@ struct Point
             this->y = 0;
         }
         if (this->x >= GLOBAL_MAX_WIDTH) {
-            this->x = GLOBAL_MAX_WIDTH;
+            this->x = GLOBAL_MAX_WIDTH-1;
         }
         if (this->y >= GLOBAL_MAX_HEIGHT) {
-            this->y = GLOBAL_MAX_HEIGHT;
+            this->y = GLOBAL_MAX_HEIGHT-1;
         }
     }
     inline bool operator==(const Point& p) const {
         return this->x == p.x && this->y == p.y;
     }    
+    inline bool isInside() const {
+        return this->x >= 0 && this->x < GLOBAL_MAX_WIDTH && this->y >= 0 && this->y < GLOBAL_MAX_HEIGHT;
+    }
 };
 
 struct Player {
@@ -164,15 +228,24 @@ struct Player {
     }
 };
 
+const char GLOBAL_MAX_BOMBS = 32; // on the board at once, far above what the stocks allow
+
+// Squares are numbered x*GLOBAL_MAX_HEIGHT + y, as Board::theBoard seen as a flat array
+constexpr int cellIndex(int x, int y) {
+    return x * GLOBAL_MAX_HEIGHT + y;
+}
+inline int cellIndex(const Point& p) {
+    return cellIndex(p.x, p.y);
+}
+inline Point cellPoint(int cell) {
+    return Point(cell / GLOBAL_MAX_HEIGHT, cell % GLOBAL_MAX_HEIGHT);
+}
+
 struct Bomb {
     char owner;
     char range;
     char timer;
-    Point p;
-    //for list
-    char previous_bomb = -1;
-    char next_bomb = -1;
-    char id = -1;
+    unsigned char cell; // see cellIndex
 
     inline Bomb() = default;
     inline Bomb(Bomb const&) = default;
@@ -184,13 +257,10 @@ struct Bomb {
         this->owner = owner;
         this->range = range;
         this->timer = timer;
-        this->p = p;
+        this->cell = cellIndex(p);
     }
-    inline void update(const char & owner,const char & range,const char & timer, const Point & p) {
-        this->owner = owner;
-        this->range = range;
-        this->timer = timer;
-        this->p = p;
+    inline Point point() const {
+        return cellPoint(this->cell);
     }
     inline void tick(){
         --this->timer;
@@ -200,24 +270,21 @@ struct Bomb {
         return this->timer <= 0;
     }
     inline bool operator==(const Bomb& b) const {
-        return  this->owner == b.owner && this->p == b.p;
+        return  this->owner == b.owner && this->cell == b.cell;
     }
      inline string toString() const {
         return "owner " + to_string(this->owner) +
                " range " + to_string(this->range) +
                " timer " + to_string(this->timer) +
-               " p " + this->p.toString() +
-               " previous_bomb " + to_string(this->previous_bomb) +
-               " next_bomb " + to_string(this->next_bomb) +
-               " id " + to_string(this->id) ;
+               " p " + this->point().toString();
     }
 };
 
+// One byte: the type, and which players stand on the square
 struct Square {
-    enum type { empty, bomb, box, box_b_range, box_b_stock, item_b_range,item_b_stock, wall};
-    type t;
-    Point p;
-    char hasPlayer;
+    enum type : unsigned char { empty, bomb, box, box_b_range, box_b_stock, item_b_range,item_b_stock, wall};
+    type t : 3;
+    unsigned char players : GLOBAL_PLAYER_NUM; // bit i for player i
 
     inline Square(Square const&) = default;
     inline Square(Square&&) = default;
@@ -225,11 +292,6 @@ struct Square {
     inline Square& operator=(Square&&) = default;
 
     inline Square() {
-        this->p = Point();
-        this->setEmpty();
-    }
-    inline Square(const Point& p) {
-        this->p = p;
         this->setEmpty();
     }
     inline void addBomb(){		
@@ -249,7 +311,7 @@ struct Square {
     }
     inline void setEmpty(){
         this->t=type::empty;
-        this->hasPlayer = 0;
+        this->players = 0;
     } 
     inline bool canEnter() const {
         return (this->t == type::empty ||
@@ -274,11 +336,11 @@ struct Square {
 			   this->t = type::empty;
 		}
     }
-    inline void addPlayer() {        
-		++this->hasPlayer;		
+    inline void addPlayer(char id) {
+		this->players |= 1 << id;
     }
-    inline void removePlayer() {
-        --this->hasPlayer;		
+    inline void removePlayer(char id) {
+        this->players &= ~(1 << id);
     }
     inline void addItem(char param1){
         if(param1 == 1){
@@ -299,13 +361,13 @@ struct Square {
         return this->t == type::bomb;
     }
 	inline bool containsPlayer() const {
-        return this->hasPlayer > 0;
+        return this->players != 0;
     }
     inline bool blocksExplosion() const {        
 		return !(this->t == type::empty );
     }
     inline bool canBeDestroyed() const {
-        return !((this->t == type::empty || this->t == type::wall) && this->hasPlayer == 0 );
+        return !((this->t == type::empty || this->t == type::wall) && this->players == 0 );
     }
     inline void explose() {
         if(this->t == type::box_b_range) {
@@ -317,96 +379,105 @@ struct Square {
         }
     }
     inline string toString() const {
-        return "location " + this->p.toString() + " type " + to_string(this->t);
+        return "type " + to_string(this->t) + " players " + to_string(this->players);
+    }
+};
+static_assert(sizeof(Square) == 1, "one byte per square");
+
+// xoshiro128** generator, passed explicitly so that a turn can be replayed from its seed
+struct Rng {
+    uint32_t s[4];
+
+    inline Rng(Rng const&) = default;
+    inline Rng(Rng&&) = default;
+    inline Rng& operator=(Rng const&) = default;
+    inline Rng& operator=(Rng&&) = default;
+
+    inline Rng(uint64_t seed = 1) {
+        this->seed(seed);
+    }
+    // splitmix64 spreads the seed over the whole state
+    inline void seed(uint64_t seed) {
+        for (char i = 0; i < 4; i += 2) {
+            seed += 0x9E3779B97F4A7C15ULL;
+            uint64_t z = seed;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            z ^= z >> 31;
+            this->s[i] = uint32_t(z);
+            this->s[i+1] = uint32_t(z >> 32);
+        }
+    }
+    static inline uint32_t rotl(uint32_t x, int k) {
+        return (x << k) | (x >> (32 - k));
+    }
+    inline uint32_t next() {
+        const uint32_t res = rotl(this->s[1] * 5, 7) * 9;
+        const uint32_t t = this->s[1] << 9;
+        this->s[2] ^= this->s[0];
+        this->s[3] ^= this->s[1];
+        this->s[1] ^= this->s[2];
+        this->s[0] ^= this->s[3];
+        this->s[2] ^= t;
+        this->s[3] = rotl(this->s[3], 11);
+        return res;
+    }
+    // Uniform in [0, 1)
+    inline float nextFloat() {
+        return (this->next() >> 8) * (1.0f / 16777216.0f);
+    }
+    // Uniform in [0, n)
+    inline uint32_t below(uint32_t n) {
+        return uint32_t((uint64_t(this->next()) * n) >> 32);
+    }
+    inline void fill(float* out, int n) {
+        for (int i = 0; i < n; ++i) {
+            out[i] = (this->next() >> 8) * (1.0f / 16777216.0f);
+        }
     }
 };
 
-char g_gene_tmp;
+// Offsets of the 5 moves: 0 stay, 1 right, 2 down, 3 left, 4 up
+const signed char GLOBAL_DIRECTION_DX[5] = {0, 1, 0, -1, 0};
+const signed char GLOBAL_DIRECTION_DY[5] = {0, 0, 1, 0, -1};
+
+// One action packed in 4 bits: direction in bits 0-2, bomb in bit 3
 struct Gene {
-    float move;
-    bool bomb;    
+    unsigned char action;
 
     inline Gene(Gene const&) = default;
     inline Gene(Gene&&) = default;
     inline Gene& operator=(Gene const&) = default;
     inline Gene& operator=(Gene&&) = default;
 
-    inline Gene () {
-        this->move = static_cast <float> (rand()) / static_cast <float> (RAND_MAX);
-        if(static_cast <float> (rand()) / static_cast <float> (RAND_MAX) > 0.50){
-            this->bomb = true;
-        }else{
-            this->bomb = false;
-        }        
+    inline Gene () : action(0) {}
+    inline Gene (Rng& rng) {
+        const uint32_t r = rng.next();
+        this->action = Gene::random(r);
     }
-    inline Gene(float m, bool b) : move(m), bomb(b) {}
-    inline void update(float m, bool b){
-        this->move = m;
-        this->bomb = b;        
+    inline Gene(char direction, bool bomb) : action(direction | (bomb << 3)) {}
+    inline explicit Gene(unsigned char action) : action(action) {}
+    // Uniform action from 16 random bits
+    static inline unsigned char random(uint32_t r) {
+        return (((r & 0x7FFF) * 5) >> 15) | ((r >> 12) & 8);
     }
-     inline char getType() const {
-        if(this->bomb)g_gene_tmp = 5;
-        else g_gene_tmp = 0;
-        
-        if (this->move <0.2) {
-            g_gene_tmp += 1;
-        } else if (this->move >=0.2 && this->move < 0.4) {
-            g_gene_tmp += 2;
-        } else if (this->move >= 0.4 && this->move < 0.6) {
-            g_gene_tmp += 3;
-        } else if (this->move >= 0.6 && this->move < 0.8) {
-            g_gene_tmp += 4;
-        } 
-        return g_gene_tmp;
+    inline void update(char direction, bool bomb){
+        this->action = direction | (bomb << 3);
+    }
+    inline bool bomb() const {
+        return this->action & 8;
+    }
+    // 0 stay, 1 right, 2 down, 3 left, 4 up
+    inline char direction() const {
+        return this->action & 7;
+    }
+    inline char getType() const {
+        return (this->bomb() ? 5 : 0) + (this->direction() + 1) % 5;
     }
 
     inline string toString() const {
-        string dir = ".";
-        if (this->move <0.2) {
-            dir = ".";
-        } else if (this->move >=0.2 && this->move < 0.4) {
-            dir = "RIGHT";
-        } else if (this->move >= 0.4 && this->move < 0.6) {
-            dir = "DOWN";
-        } else if (this->move >= 0.6 && this->move < 0.8) {
-            dir = "LEFT";
-        } else if (this->move >= 0.8) {
-            dir = "UP";
-        }
-        return "move: " + dir + " bomb: " + to_string(this->bomb);
-    }
-    
-    inline void cross(const Gene& g1, const Gene& g2) {
-        float gene_proba = static_cast <float> (rand()) / static_cast <float> (RAND_MAX) ;
-        if (gene_proba < 0.4) {
-            // Keep g1
-            *this = g1;
-        } else if (gene_proba < 0.8) {
-            // Keep g2
-            *this = g2;            
-        } else if (gene_proba < 0.85) {
-            this->update(g1.move * g2.move, g1.bomb || g2.bomb);            
-        } else if (gene_proba < 0.90) {
-            this->update(g1.move * g2.move, g1.bomb  &&  g2.bomb);            
-        } else {
-            *this = Gene();
-        }
-    }
-    inline void mutate(const Gene& g1) {
-        float gene_proba = static_cast <float> (rand()) / static_cast <float> (RAND_MAX) ;
-        if (gene_proba < 0.4) {
-            // Keep g1
-            this->move = g1.move;
-            this->bomb = g1.bomb;
-        } else if (gene_proba < 0.7){
-            this->move *= g1.move;
-            this->bomb = g1.bomb;            
-        } else if (gene_proba < 0.95) {            
-            this->move = g1.move;
-            this->bomb = !g1.bomb;
-        } else {
-            *this = Gene();
-        }
+        const char* dirs[5] = {".", "RIGHT", "DOWN", "LEFT", "UP"};
+        return "move: " + string(dirs[this->direction()]) + " bomb: " + to_string(this->bomb());
     }
 };
 
@@ -491,31 +562,104 @@ struct myList
 
 };
 
-char g_board_i;
-char g_board_x;
-char g_board_y;
-char g_board_init_x;
-char g_board_killPlayersOnSquare_i;
-char g_board_processBomb_x;
-char g_board_processBomb_y;
-char g_board_update_i;
+const signed char GLOBAL_MAX_RAY = GLOBAL_MAX_WIDTH > GLOBAL_MAX_HEIGHT ? GLOBAL_MAX_WIDTH-1 : GLOBAL_MAX_HEIGHT-1;
+// For every square and direction (right, left, down, up) the ordered squares a
+// blast goes through, as indexes in Board::theBoard seen as a flat array.
+// A bomb of range r reaches the first min(r-1, length) of them.
+struct BlastRays {
+    unsigned char cells[GLOBAL_MAX_WIDTH*GLOBAL_MAX_HEIGHT][4][GLOBAL_MAX_RAY];
+    char length[GLOBAL_MAX_WIDTH*GLOBAL_MAX_HEIGHT][4];
+
+    static constexpr int index(int x, int y) {
+        return cellIndex(x, y);
+    }
+    static inline int index(const Point& p) {
+        return index(p.x, p.y);
+    }
+    constexpr BlastRays() : cells(), length() {
+        const int dx[4] = {1, -1, 0, 0};
+        const int dy[4] = {0, 0, 1, -1};
+        for (int x = 0; x < GLOBAL_MAX_WIDTH; ++x) {
+            for (int y = 0; y < GLOBAL_MAX_HEIGHT; ++y) {
+                for (int d = 0; d < 4; ++d) {
+                    int n = 0;
+                    for (int cx = x + dx[d], cy = y + dy[d];
+                         cx >= 0 && cx < GLOBAL_MAX_WIDTH && cy >= 0 && cy < GLOBAL_MAX_HEIGHT;
+                         cx += dx[d], cy += dy[d]) {
+                        this->cells[index(x, y)][d][n++] = index(cx, cy);
+                    }
+                    this->length[index(x, y)][d] = n;
+                }
+            }
+        }
+    }
+};
+constexpr BlastRays GLOBAL_BLAST_RAYS = BlastRays();
+
+const uint GLOBAL_UNDO_KEYS = 192;
+
+// Squares a rollout changed, by cellIndex. Board::rewind copies them back
+// from the untouched root board, with the whole bomb array.
+struct UndoLog {
+    uint64_t touched [GLOBAL_UNDO_KEYS / 64] = {0};
+
+    inline void touch(uint key) {
+        this->touched[key >> 6] |= 1ULL << (key & 63);
+    }
+};
 
-int g_board_update_score_inc;
-int g_board_player_temp_score [GLOBAL_PLAYER_NUM];  
-Point g_board_newPositions [GLOBAL_PLAYER_NUM];  
+// Zobrist keys are drawn on the fly by mixing the packed feature
+inline uint64_t zobrist(uint64_t feature) {
+    uint64_t z = feature + 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+const uint64_t GLOBAL_ZOBRIST_SQUARE = 1ULL << 56;
+const uint64_t GLOBAL_ZOBRIST_BOMB = 2ULL << 56;
+const uint64_t GLOBAL_ZOBRIST_PLAYER = 3ULL << 56;
+const uint64_t GLOBAL_ZOBRIST_DEPTH = 4ULL << 56;
+const uint64_t GLOBAL_ZOBRIST_STAMP = 5ULL << 56;
 
-myQueue<char> g_board_explosionList;
-myQueue<Square*> g_board_deletedObjects;
-myQueue<Square*> g_board_deleteBox;
+// Rewards of a rollout step, multiplier being GLOBAL_GENOME_SIZE - step so that early gains count more.
+// The leaf weights score the state a shortened rollout stops at, see LeafEvaluator.
+struct ScoreWeights {
+    int box = 3; // per box destroyed, times the multiplier
+    int rangeItem = 1; // times the multiplier
+    int stockItem = 2; // times the multiplier, while the stock is under stockCap
+    int stockCap = 6;
+    int bomb = -1; // per bomb dropped
+    int stay = -1; // per step without moving
+    int leafSpotBox = 3; // per box hit from the best bombing spot in reach
+    int leafSpotStep = 1; // per step to walk to that spot
+    int leafItemStep = 1; // per step to the closest item
+    int leafEscapeStep = 2; // per step out of the blasts of the bombs still ticking
+    int leafTrapped = -200; // when there is no way out
+};
+// Per-thread working memory of Board::update, and the weights it scores with
+struct SimScratch {
+    ScoreWeights weights;
+    myQueue<char> explosionList;
+    myQueue<Square*> deletedObjects;
+    myQueue<Square*> deleteBox;
+};
 
 struct Board
 {
     Square theBoard[GLOBAL_MAX_WIDTH][GLOBAL_MAX_HEIGHT];
+    char bombSlots[GLOBAL_MAX_WIDTH*GLOBAL_MAX_HEIGHT]; // by cellIndex, only meaningful while the square holds a bomb
     Player players [GLOBAL_PLAYER_NUM];
-    Bomb bombs[100];
-    char firstBomb =-1;
-    char lastBomb =-1;
+    Bomb bombs[GLOBAL_MAX_BOMBS]; // [0, bombNum), rollouts keep them in the order they were dropped
+    char bombNum = 0;
     int scores [GLOBAL_PLAYER_NUM];    
+    UndoLog* journal = NULL; // when set, update() logs what it changes
+    // Zobrist hash of squares and bombs, kept up to date while hashed is set.
+    // Bombs are keyed by the step they explode at so that ticking keeps the hash.
+    uint64_t hash = 0;
+    bool hashed = false;
+    char step = 0;
+    char playerNum = GLOBAL_PLAYER_NUM; // players [playerNum, GLOBAL_PLAYER_NUM) are not in the game
+    static_assert(GLOBAL_MAX_WIDTH*GLOBAL_MAX_HEIGHT <= GLOBAL_UNDO_KEYS, "one undo key per square");
     
     inline Board(Board const&) = default;
     inline Board(Board&&) = default;
@@ -523,44 +667,110 @@ struct Board
     inline Board& operator=(Board&&) = default;
 
     inline Board(){
-        for(g_board_i= 0; g_board_i< GLOBAL_PLAYER_NUM;++g_board_i){
-            this->scores[g_board_i] = 0;
+        for(char i= 0; i< GLOBAL_PLAYER_NUM;++i){
+            this->scores[i] = 0;
+        }
+        for(char y= 0; y< GLOBAL_MAX_HEIGHT;++y){
+            for(char x= 0; x< GLOBAL_MAX_WIDTH;++x){
+               this->theBoard[x][y]=Square();
+            }
+        }
+        for(char i= 0; i< GLOBAL_PLAYER_NUM;++i){
+           this->players[i] = Player(i,Point());
         }
-        for(g_board_y= 0; g_board_y< GLOBAL_MAX_HEIGHT;++g_board_y){
-            for(g_board_x= 0; g_board_x< GLOBAL_MAX_WIDTH;++g_board_x){
-               this->theBoard[g_board_x][g_board_y]=Square(Point(g_board_x, g_board_y));
+        this->bombNum = 0;
+    }
+    // Moves and the bombs of the root board are not recorded, rewind() finds them from the players and root
+    inline void record(const Square& square) {
+        if (this->journal != NULL) {
+            this->journal->touch(&square - &(this->theBoard[0][0]));
+        }
+    }
+    inline uint64_t squareKey(const Square& square) const {
+        if (square.t == Square::type::empty) {
+            return 0;
+        }
+        return zobrist(GLOBAL_ZOBRIST_SQUARE | (&square - &(this->theBoard[0][0])) << 8 | square.t);
+    }
+    inline uint64_t bombKey(const Bomb& bomb) const {
+        return zobrist(GLOBAL_ZOBRIST_BOMB | uint64_t(bomb.cell) << 24 | bomb.owner << 16 | bomb.range << 8 | (unsigned char)(this->step + bomb.timer));
+    }
+    inline void rehashSquare(const Square& square) {
+        if (this->hashed) {
+            this->hash ^= this->squareKey(square);
+        }
+    }
+    inline void rehashBomb(const Bomb& bomb) {
+        if (this->hashed) {
+            this->hash ^= this->bombKey(bomb);
+        }
+    }
+    inline uint64_t computeHash() const {
+        uint64_t res = 0;
+        const Square* squares = &(this->theBoard[0][0]);
+        for (int i = 0; i < GLOBAL_MAX_WIDTH*GLOBAL_MAX_HEIGHT; ++i) {
+            res ^= this->squareKey(squares[i]);
+        }
+        for (char i = 0; i < this->bombNum; ++i) {
+            res ^= this->bombKey(this->bombs[i]);
+        }
+        return res;
+    }
+    // Back to root, which must be the board this one was copied from before recording
+    inline void rewind(const Board& root) {
+        Square* squares = &(this->theBoard[0][0]);
+        const Square* rootSquares = &(root.theBoard[0][0]);
+        // Squares only left or entered by players differ by their player bits
+        for (char i = 0; i < GLOBAL_PLAYER_NUM; ++i) {
+            if (root.players[i].isAlive) {
+                squares[cellIndex(this->players[i].p)].removePlayer(i);
+                squares[cellIndex(root.players[i].p)].addPlayer(i);
             }
         }
-        for(g_board_i= 0; g_board_i< GLOBAL_PLAYER_NUM;++g_board_i){
-           this->players[g_board_i] = Player(g_board_i,Point());
+        for (char i = 0; i < GLOBAL_PLAYER_NUM; ++i) {
+            this->players[i] = root.players[i];
+            this->scores[i] = root.scores[i];
+        }
+        this->bombNum = root.bombNum;
+        this->hash = root.hash;
+        this->step = root.step;
+        memcpy(this->bombs, root.bombs, root.bombNum * sizeof(Bomb));
+        for (char i = 0; i < root.bombNum; ++i) {
+            this->bombSlots[root.bombs[i].cell] = i;
+        }
+        uint64_t* touched = this->journal->touched;
+        for (uint w = 0; w < GLOBAL_UNDO_KEYS / 64; ++w) {
+            while (touched[w]) {
+                const uint key = w * 64 + __builtin_ctzll(touched[w]);
+                touched[w] &= touched[w] - 1;
+                squares[key] = rootSquares[key];
+            }
         }
-        this->firstBomb = -1;
-        this->lastBomb = -1;
     }
     inline Square get(int x, int y) {
         return this->theBoard[x][y];
     }
-    inline void init(int i, string row)
+    inline void init(int i, const char* row)
     {
-        for(g_board_init_x =0;g_board_init_x<GLOBAL_MAX_WIDTH;++g_board_init_x)
+        for(char x =0;x<GLOBAL_MAX_WIDTH;++x)
         {
-            if (row[g_board_init_x] == '.') {
-                this->theBoard[g_board_init_x][i].setEmpty();
-            }else if (row[g_board_init_x] == 'X') {
-                this->theBoard[g_board_init_x][i].addWall();
+            if (row[x] == '.') {
+                this->theBoard[x][i].setEmpty();
+            }else if (row[x] == 'X') {
+                this->theBoard[x][i].addWall();
             } else {
-                this->theBoard[g_board_init_x][i].addBox(row[g_board_init_x]);
+                this->theBoard[x][i].addBox(row[x]);
             }
         }
     }
-    inline void init(int entityType, int owner, int x, int y, int param1, int param2, const Board& previous_board)
+    inline void init(int entityType, int owner, int x, int y, int param1, int param2, const Board& previous_board, int turn)
     {        
         if (entityType == 0) { // Player
-            if(global_turn == 1){
+            if(turn == 1){
                 this->players[owner].isAlive = true;
             }
             if (this->players[owner].isAlive){                
-                this->theBoard[x][y].addPlayer();
+                this->theBoard[x][y].addPlayer(owner);
                 this->players[owner].update(owner, Point(x, y));                        
                 if (previous_board.theBoard[x][y].hasBonus()) { // we take an item                       
                     if(previous_board.theBoard[x][y].t == Square::type::item_b_range){
@@ -585,149 +795,116 @@ struct Board
         // Only increase if we are not dead
         this->scores[id] += n;
     }
-    inline void killPlayersOnSquare(const Point& p) {
-        for (g_board_killPlayersOnSquare_i=0; g_board_killPlayersOnSquare_i<GLOBAL_PLAYER_NUM ; ++g_board_killPlayersOnSquare_i) {
-            if (this->players[g_board_killPlayersOnSquare_i].p == p) {
+    inline void killPlayersOnSquare(const Square& square) {
+        for (char i=0; i<GLOBAL_PLAYER_NUM ; ++i) {
+            if ((square.players >> i) & 1) {
                 // Then player is dead
-                this->players[g_board_killPlayersOnSquare_i].kill();                
+                this->players[i].kill();                
             }
         }
     }
-    inline void addBombToExplosionList(const Point & p, myQueue<char> &explosionList){
-        // Add bombs in point that have timer > 0        
-        char i = this->firstBomb;        
-        while(i!=-1){
-            if (this->bombs[i].p == p && this->bombs[i].timer > 0) {
-                this->bombs[i].timer = 0;
-                explosionList.push(i);
-            }
-            i = this->bombs[i].next_bomb;
+    // Slot of the bomb on the cell, -1 if none
+    inline char bombAt(int cell) const {
+        return (&(this->theBoard[0][0]))[cell].containsBomb() ? this->bombSlots[cell] : -1;
+    }
+    inline void addBombToExplosionList(int cell, myQueue<char> &explosionList){
+        // Add the bomb on the cell if its timer > 0, exploded bombs stay at 0 until bigBadaboum drops them
+        const char i = this->bombAt(cell);
+        if (i != -1 && this->bombs[i].timer > 0) {
+            this->rehashBomb(this->bombs[i]);
+            this->bombs[i].timer = 0;
+            this->rehashBomb(this->bombs[i]);
+            explosionList.push(i);
         }
     }
     inline bool processBomb(const char & bombId, myQueue<char> &explosionList, myQueue<Square*> &deletedObjects) {        
-        // Right
-        for (g_board_processBomb_x=1; g_board_processBomb_x < this->bombs[bombId].range && this->bombs[bombId].p.x+g_board_processBomb_x < GLOBAL_MAX_WIDTH; ++g_board_processBomb_x) {
-            if (this->theBoard[this->bombs[bombId].p.x+g_board_processBomb_x][this->bombs[bombId].p.y].canBeDestroyed()) {
-                deletedObjects.push(&(this->theBoard[this->bombs[bombId].p.x+g_board_processBomb_x][this->bombs[bombId].p.y]));
-            }
-            if (this->theBoard[this->bombs[bombId].p.x+g_board_processBomb_x][this->bombs[bombId].p.y].blocksExplosion()) {
-                if (this->theBoard[this->bombs[bombId].p.x+g_board_processBomb_x][this->bombs[bombId].p.y].containsBomb()){
-                    this->addBombToExplosionList(Point(this->bombs[bombId].p.x+g_board_processBomb_x,this->bombs[bombId].p.y), explosionList);
-                }
-                if (this->theBoard[this->bombs[bombId].p.x+g_board_processBomb_x][this->bombs[bombId].p.y].isBox()) {
-                    // Give point to player
-                    this->players[this->bombs[bombId].owner].increaseScore();                    
-                }
-                break;
-            }
-        }
-        // Left
-        for (g_board_processBomb_x=1; g_board_processBomb_x < this->bombs[bombId].range && this->bombs[bombId].p.x-g_board_processBomb_x >= 0; ++g_board_processBomb_x) {
-            if (this->theBoard[this->bombs[bombId].p.x-g_board_processBomb_x][this->bombs[bombId].p.y].canBeDestroyed()) {
-                deletedObjects.push(&(this->theBoard[this->bombs[bombId].p.x-g_board_processBomb_x][this->bombs[bombId].p.y]));
-            }
-            if (this->theBoard[this->bombs[bombId].p.x-g_board_processBomb_x][this->bombs[bombId].p.y].blocksExplosion()) {
-                if (this->theBoard[this->bombs[bombId].p.x-g_board_processBomb_x][this->bombs[bombId].p.y].containsBomb()){
-                    this->addBombToExplosionList(Point(this->bombs[bombId].p.x-g_board_processBomb_x,this->bombs[bombId].p.y), explosionList);
-                }
-                if (this->theBoard[this->bombs[bombId].p.x-g_board_processBomb_x][this->bombs[bombId].p.y].isBox()) {
-                    // Give point to player                    
-                    this->players[this->bombs[bombId].owner].increaseScore();
-                }
-                break;
-            }
-        }
-        // Down
-        for (g_board_processBomb_y=1; g_board_processBomb_y < this->bombs[bombId].range && this->bombs[bombId].p.y+g_board_processBomb_y < GLOBAL_MAX_HEIGHT; ++g_board_processBomb_y) {
-            if (this->theBoard[this->bombs[bombId].p.x][this->bombs[bombId].p.y+g_board_processBomb_y].canBeDestroyed()) {
-                deletedObjects.push(&(this->theBoard[this->bombs[bombId].p.x][this->bombs[bombId].p.y+g_board_processBomb_y]));                
-            }
-            if (this->theBoard[this->bombs[bombId].p.x][this->bombs[bombId].p.y+g_board_processBomb_y].blocksExplosion()) {
-                if (this->theBoard[this->bombs[bombId].p.x][this->bombs[bombId].p.y+g_board_processBomb_y].containsBomb()){
-                    this->addBombToExplosionList(Point(this->bombs[bombId].p.x,this->bombs[bombId].p.y+g_board_processBomb_y), explosionList);
-                }
-                if (this->theBoard[this->bombs[bombId].p.x][this->bombs[bombId].p.y+g_board_processBomb_y].isBox()) {
-                    // Give point to player                    
-                    this->players[this->bombs[bombId].owner].increaseScore();
+        const Bomb& bomb = this->bombs[bombId];
+        const int origin = bomb.cell;
+        Square* squares = &(this->theBoard[0][0]);
+        // Right, Left, Down, Up: walk the precomputed ray until the first blocker
+        for (char d = 0; d < 4; ++d) {
+            const unsigned char* ray = GLOBAL_BLAST_RAYS.cells[origin][d];
+            const char length = min<char>(bomb.range - 1, GLOBAL_BLAST_RAYS.length[origin][d]);
+            for (char k = 0; k < length; ++k) {
+                Square& square = squares[ray[k]];
+                if (square.canBeDestroyed()) {
+                    deletedObjects.push(&square);
                 }
-                break;
-            }
-        }
-        // Up
-        for (g_board_processBomb_y=1; g_board_processBomb_y < this->bombs[bombId].range && this->bombs[bombId].p.y-g_board_processBomb_y >= 0; ++g_board_processBomb_y) {
-            if (this->theBoard[this->bombs[bombId].p.x][this->bombs[bombId].p.y-g_board_processBomb_y].canBeDestroyed()) {
-                deletedObjects.push(&(this->theBoard[this->bombs[bombId].p.x][this->bombs[bombId].p.y-g_board_processBomb_y]));
-            }
-            if (this->theBoard[this->bombs[bombId].p.x][this->bombs[bombId].p.y-g_board_processBomb_y].blocksExplosion()) {
-                if (this->theBoard[this->bombs[bombId].p.x][this->bombs[bombId].p.y-g_board_processBomb_y].containsBomb()){
-                    this->addBombToExplosionList(Point(this->bombs[bombId].p.x,this->bombs[bombId].p.y-g_board_processBomb_y), explosionList);
-                }
-                if (this->theBoard[this->bombs[bombId].p.x][this->bombs[bombId].p.y-g_board_processBomb_y].isBox()) {
-                    // Give point to player
-                    this->players[this->bombs[bombId].owner].increaseScore();                    
+                if (square.blocksExplosion()) {
+                    if (square.containsBomb()) {
+                        this->addBombToExplosionList(ray[k], explosionList);
+                    }
+                    if (square.isBox()) {
+                        // Give point to player
+                        this->players[bomb.owner].increaseScore();
+                    }
+                    break;
                 }
-                break;
             }
         }
         //add bomb to player stock
-        ++(this->players[this->bombs[bombId].owner].reloading_stock);
-        //remove bomb from board
-        if (this->theBoard[this->bombs[bombId].p.x][this->bombs[bombId].p.y].containsPlayer()) {
-            this->killPlayersOnSquare(this->bombs[bombId].p);
-        }
-        deletedObjects.push(&(this->theBoard[this->bombs[bombId].p.x][this->bombs[bombId].p.y]));
-        //remove bomb from list
-        this->remove_bomb(this->bombs[bombId].id);
+        ++(this->players[bomb.owner].reloading_stock);
+        //remove bomb from board, its slot is freed by bigBadaboum
+        if (squares[origin].containsPlayer()) {
+            this->killPlayersOnSquare(squares[origin]);
+        }
+        deletedObjects.push(&(squares[origin]));
         return false; // Default we suppose we are safe
     }
-    inline void bigBadaboum(myQueue<Square*>& deleteBox) {        
+    inline void bigBadaboum(SimScratch& scratch) {        
         //if (global_debug) cerr << "bigBadaboum " << endl;
         // Go decrement all bomb timers
-		g_board_explosionList.setEmpty();
-		g_board_deletedObjects.setEmpty();        
-        char i = this->firstBomb;                
-        while(i != -1){        
+		scratch.explosionList.setEmpty();
+		scratch.deletedObjects.setEmpty();        
+        for (char i = 0; i < this->bombNum; ++i) {
             this->bombs[i].tick();
             if (this->bombs[i].isExploding()) {
-                g_board_explosionList.push(i);
+                scratch.explosionList.push(i);
             }            
-            i = this->bombs[i].next_bomb;
         }
         // Simultaneous explosions
-        while(!g_board_explosionList.empty()){                        
-            processBomb(g_board_explosionList.front(),g_board_explosionList, g_board_deletedObjects);
-            g_board_explosionList.pop(); // Delete 1st elem
-            //clean bomb list
+        while(!scratch.explosionList.empty()){                        
+            processBomb(scratch.explosionList.front(),scratch.explosionList, scratch.deletedObjects);
+            scratch.explosionList.pop(); // Delete 1st elem
         }        
+        //clean bomb list, the slots keep their order
+        if (scratch.explosionList.next > 0) {
+            char kept = 0;
+            for (char i = 0; i < this->bombNum; ++i) {
+                if (this->bombs[i].timer > 0) {
+                    this->bombSlots[this->bombs[i].cell] = kept;
+                    this->bombs[kept++] = this->bombs[i];
+                } else {
+                    this->rehashBomb(this->bombs[i]);
+                }
+            }
+            this->bombNum = kept;
+        }
         // Cleaning the map
-        while(!g_board_deletedObjects.empty()){
-            Square* pSquare = g_board_deletedObjects.front();         
+        while(!scratch.deletedObjects.empty()){
+            Square* pSquare = scratch.deletedObjects.front();         
+            this->record(*pSquare);
             if (pSquare->containsPlayer()) {                
-                this->killPlayersOnSquare(pSquare->p);
+                this->killPlayersOnSquare(*pSquare);
             }
             if (!pSquare->isBox()) {
+                this->rehashSquare(*pSquare);
                 pSquare->explose();
+                this->rehashSquare(*pSquare);
             } else {
-                deleteBox.push(pSquare);
+                scratch.deleteBox.push(pSquare);
             }
-            g_board_deletedObjects.pop();
+            scratch.deletedObjects.pop();
         }
     }     
     
     inline Point getNext(const Gene& g, const Point& p) const
     {
-        Point pres(p);
-        if (g.move <0.2) {
+        const char d = g.direction();
+        if (d == 0) {
             return p;
-        } else if (g.move >=0.2 && g.move < 0.4) {
-            pres.x += 1;
-        } else if (g.move >= 0.4 && g.move < 0.6) {
-            pres.y += 1;
-        } else if (g.move >= 0.6 && g.move < 0.8) {
-            pres.x -= 1;
-        } else if (g.move >= 0.8) {
-            pres.y -= 1;
         }
+        Point pres(p.x + GLOBAL_DIRECTION_DX[d], p.y + GLOBAL_DIRECTION_DY[d]);
         pres.correctBounds();
         if ( ! this->theBoard[pres.x][pres.y].canEnter() ) {
             return p;// Cannot move there, stay where we are
@@ -737,106 +914,126 @@ struct Board
 
     inline Point getNextWithoutCheck(const Gene& g, const Point& p) const
     {
-        Point pres(p);
-        if (g.move <0.2) {
-            return p;
-        } else if (g.move >=0.2 && g.move < 0.4) {
-            pres.x += 1;
-        } else if (g.move >= 0.4 && g.move < 0.6) {
-            pres.y += 1;
-        } else if (g.move >= 0.6 && g.move < 0.8) {
-            pres.x -= 1;
-        } else if (g.move >= 0.8) {
-            pres.y -= 1;
-        }
+        const char d = g.direction();
+        Point pres(p.x + GLOBAL_DIRECTION_DX[d], p.y + GLOBAL_DIRECTION_DY[d]);
         pres.correctBounds();
         return pres;
     }
-    inline void update(const Gene genes[GLOBAL_PLAYER_NUM] , int multiplier){
+    // Highest player id of the entities read on the first turn, plus one
+    inline void countPlayers() {
+        this->playerNum = 2;
+        for (char i = 2; i < GLOBAL_PLAYER_NUM; ++i) {
+            if (this->players[i].isAlive) {
+                this->playerNum = i + 1;
+            }
+        }
+    }
+    inline void update(const Gene genes[GLOBAL_PLAYER_NUM], int multiplier, SimScratch& scratch) {
+        forPlayerNum(this->playerNum, [&](auto players) {
+            this->updateFor<decltype(players)::value>(genes, multiplier, scratch);
+        });
+    }
+    template <char P>
+    inline void updateFor(const Gene genes[GLOBAL_PLAYER_NUM] , int multiplier, SimScratch& scratch){
+        char i;
+        int score_inc;
+        int temp_score [GLOBAL_PLAYER_NUM];
+        Point newPositions [GLOBAL_PLAYER_NUM];
+        const ScoreWeights& weights = scratch.weights;
 
         // cf. Experts rules for details
         // First: bombs explodes (if reach timer 0) and destroy objects        
-        for(g_board_update_i = 0; g_board_update_i < GLOBAL_PLAYER_NUM;++g_board_update_i){
-            g_board_player_temp_score[g_board_update_i] = this->players[g_board_update_i].score;
-            //if (global_debug) cerr << "P " << to_string(g_board_update_i) << " " << this->players[g_board_update_i].toString() << endl;                
+        for(i = 0; i < P;++i){
+            temp_score[i] = this->players[i].score;
+            //if (global_debug) cerr << "P " << to_string(i) << " " << this->players[i].toString() << endl;                
         }        
-		g_board_deleteBox.setEmpty();
-        this->bigBadaboum(g_board_deleteBox);
-        for(g_board_update_i = 0; g_board_update_i < GLOBAL_PLAYER_NUM;++g_board_update_i){        
-            if(this->players[g_board_update_i].isAlive){
-                g_board_newPositions[g_board_update_i] = this->getNext(genes[g_board_update_i], this->players[g_board_update_i].p);
-                //if (global_debug) cerr << "P " << to_string(g_board_update_i) << "new " << g_board_newPositions[g_board_update_i].toString() << endl;                
+		scratch.deleteBox.setEmpty();
+        ++this->step;
+        this->bigBadaboum(scratch);
+        for(i = 0; i < P;++i){        
+            if(this->players[i].isAlive){
+                newPositions[i] = this->getNext(genes[i], this->players[i].p);
+                //if (global_debug) cerr << "P " << to_string(i) << "new " << newPositions[i].toString() << endl;                
             }
         }                
-        for(g_board_update_i = 0; g_board_update_i < GLOBAL_PLAYER_NUM;++g_board_update_i){
-            g_board_update_score_inc = this->players[g_board_update_i].score - g_board_player_temp_score[g_board_update_i];
-            if(this->players[g_board_update_i].isAlive){
+        for(i = 0; i < P;++i){
+            score_inc = this->players[i].score - temp_score[i];
+            if(this->players[i].isAlive){
                 // Treat the bomb dropped case TODO include in bigBadaboum                
                 //if (global_debug) {cerr << "Stock before planting " << to_string(this->players[id].cur_stock) << endl;}
-                if (genes[g_board_update_i].bomb && this->players[g_board_update_i].cur_stock > 0 && !this->theBoard[this->players[g_board_update_i].p.x][this->players[g_board_update_i].p.y].containsBomb()) {
+                if (genes[i].bomb() && this->players[i].cur_stock > 0 && !this->theBoard[this->players[i].p.x][this->players[i].p.y].containsBomb() && this->bombNum < GLOBAL_MAX_BOMBS) {
                     // Add bomb on the square and in the list of bombs too
-                    this->addBomb(this->players[g_board_update_i]);
-                    this->increaseScore(-1,g_board_update_i);
+                    this->addBomb(this->players[i]);
+                    this->increaseScore(weights.bomb,i);
                 }
                 //if (global_debug) {cerr << "Stock after planting " << to_string(this->players[id].cur_stock) << endl;}
         
-                this->increaseScore(g_board_update_score_inc * multiplier * 3,g_board_update_i);
+                this->increaseScore(score_inc * multiplier * weights.box,i);
                 //if (global_debug) cerr << "Player is: " << this->players[myId].p.toString() << endl;
                 //if (global_debug) cerr << "Square ok: " << this->theBoard[this->players[myId].p.x][this->players[myId].p.y].containsPlayer() << endl;
-                //if (global_debug) cerr << "score " << g_board_update_score_inc << " boxes with multiplier " << multiplier << endl;
+                //if (global_debug) cerr << "score " << score_inc << " boxes with multiplier " << multiplier << endl;
                 // Then: we move the player(s)                            
-                if(!(g_board_newPositions[g_board_update_i] == this->players[g_board_update_i].p)){
+                if(!(newPositions[i] == this->players[i].p)){
                     // Treat the movement of the player
-                    if ((this->theBoard[g_board_newPositions[g_board_update_i].x][g_board_newPositions[g_board_update_i].y].canEnter()) &&
-                       g_board_newPositions[g_board_update_i].x >= 0 && g_board_newPositions[g_board_update_i].x < GLOBAL_MAX_WIDTH &&
-                       g_board_newPositions[g_board_update_i].y >= 0 && g_board_newPositions[g_board_update_i].y < GLOBAL_MAX_HEIGHT) { // valid move
-                        if (this->theBoard[g_board_newPositions[g_board_update_i].x][g_board_newPositions[g_board_update_i].y].hasBonus()) { // we take an item                           
-                           if(this->theBoard[g_board_newPositions[g_board_update_i].x][g_board_newPositions[g_board_update_i].y].t == Square::type::item_b_range){
-                               ++this->players[g_board_update_i].range;
-                               this->increaseScore(1*multiplier,g_board_update_i);                           
+                    if ((this->theBoard[newPositions[i].x][newPositions[i].y].canEnter()) &&
+                       newPositions[i].x >= 0 && newPositions[i].x < GLOBAL_MAX_WIDTH &&
+                       newPositions[i].y >= 0 && newPositions[i].y < GLOBAL_MAX_HEIGHT) { // valid move
+                        if (this->theBoard[newPositions[i].x][newPositions[i].y].hasBonus()) { // we take an item                           
+                           if(this->theBoard[newPositions[i].x][newPositions[i].y].t == Square::type::item_b_range){
+                               ++this->players[i].range;
+                               this->increaseScore(weights.rangeItem*multiplier,i);
                            }else{
-                               if(this->players[g_board_update_i].cur_stock < 6) this->increaseScore(2*multiplier,g_board_update_i);                                                          
-                               ++this->players[g_board_update_i].cur_stock;
+                               if(this->players[i].cur_stock < weights.stockCap) this->increaseScore(weights.stockItem*multiplier,i);
+                               ++this->players[i].cur_stock;
                            }
-                           this->theBoard[g_board_newPositions[g_board_update_i].x][g_board_newPositions[g_board_update_i].y].removeBonus();
+                           this->record(this->theBoard[newPositions[i].x][newPositions[i].y]);
+                           this->rehashSquare(this->theBoard[newPositions[i].x][newPositions[i].y]);
+                           this->theBoard[newPositions[i].x][newPositions[i].y].removeBonus();
+                           this->rehashSquare(this->theBoard[newPositions[i].x][newPositions[i].y]);
                         }
                         // update the new square with the player information
-                        // int i = g_board_update_i;
-                        // if (global_debug) cerr << "P" << i << " old " << this->players[g_board_update_i].p << endl;
-                        //if (global_debug) cerr << "P " << to_string(g_board_update_i) << "old " << this->players[g_board_update_i].p.toString() << endl;  
-                        this->theBoard[this->players[g_board_update_i].p.x][this->players[g_board_update_i].p.y].removePlayer();
-                        this->theBoard[g_board_newPositions[g_board_update_i].x][g_board_newPositions[g_board_update_i].y].addPlayer();
+                        // int i = i;
+                        // if (global_debug) cerr << "P" << i << " old " << this->players[i].p << endl;
+                        //if (global_debug) cerr << "P " << to_string(i) << "old " << this->players[i].p.toString() << endl;  
+                        this->theBoard[this->players[i].p.x][this->players[i].p.y].removePlayer(i);
+                        this->theBoard[newPositions[i].x][newPositions[i].y].addPlayer(i);
                         //update the player
-                        this->players[g_board_update_i].p.x = g_board_newPositions[g_board_update_i].x;
-                        this->players[g_board_update_i].p.y = g_board_newPositions[g_board_update_i].y;
+                        this->players[i].p.x = newPositions[i].x;
+                        this->players[i].p.y = newPositions[i].y;
                     }
                 } else{
-                    this->increaseScore(-1,g_board_update_i); // move better than stay
+                    this->increaseScore(weights.stay,i); // move better than stay
                 }
-                this->players[g_board_update_i].reload();
+                this->players[i].reload();
                 //if (global_debug) {cerr << "Player moved " << this->players[myId].p.toString() << endl;}
             }else {
-                this->scores[g_board_update_i] = INT_MIN;
+                this->scores[i] = INT_MIN;
             }
 		}
 		// Clean boxes
-        while (!g_board_deleteBox.empty()) {
-            Square* pSquare = g_board_deleteBox.front();
+        while (!scratch.deleteBox.empty()) {
+            Square* pSquare = scratch.deleteBox.front();
+            this->record(*pSquare);
+            this->rehashSquare(*pSquare);
             pSquare->explose();
-            g_board_deleteBox.pop();
+            this->rehashSquare(*pSquare);
+            scratch.deleteBox.pop();
         }
     }
 
     inline void addBomb(Player& pyro){
         --(pyro.cur_stock);
         this->push_bomb(pyro.id, pyro.range, 8 /* Timer 8 for all new bombs */, pyro.p);
+        this->record(this->theBoard[pyro.p.x][pyro.p.y]);
+        this->rehashSquare(this->theBoard[pyro.p.x][pyro.p.y]);
         this->theBoard[pyro.p.x][pyro.p.y].addBomb();
+        this->rehashSquare(this->theBoard[pyro.p.x][pyro.p.y]);
     }
 
     inline void toString(){
         for(char y= 0; y< GLOBAL_MAX_HEIGHT;++y){
             for(char x= 0; x< GLOBAL_MAX_WIDTH;++x){
-                cerr << this->theBoard[x][y].t + 10 * (this->theBoard[x][y].hasPlayer+1) <<" ";
+                cerr << this->theBoard[x][y].t + 10 * (__builtin_popcount(this->theBoard[x][y].players)+1) <<" ";
             }
             cerr << endl;
         }
@@ -844,61 +1041,367 @@ struct Board
     
     //for bomb list 
     inline void clearBombs(){
-        this->firstBomb=-1;
-        this->lastBomb=-1;
-        for(char i=0; i< 100; ++i){
-            this->bombs[i].id = -1;
-            this->bombs[i].previous_bomb = -1;
-            this->bombs[i].next_bomb = -1;
-        }        
+        while(this->bombNum > 0){
+            this->remove_bomb(this->bombNum - 1);
+        }
     }
     inline void push_bomb(const char& owner,const char& param2,const char& param1,const Point& p){
-        if(this->firstBomb==-1 || this->lastBomb==-1){
-            this->firstBomb=0;        
-            this->lastBomb=0;        
+        if(this->bombNum == GLOBAL_MAX_BOMBS){// all slots taken, cannot happen with the game stocks
+            return;
         }
-        
-        if(this->bombs[this->lastBomb].id == -1){// first element
-            this->bombs[this->lastBomb].update(owner, param2, param1, p);
-            this->bombs[this->lastBomb].id = this->lastBomb;
-            this->bombs[this->lastBomb].previous_bomb = -1;
-            this->bombs[this->lastBomb].next_bomb = -1;            
-        } else {
-            char i = this->lastBomb+1;
-            while(this->bombs[i].id != -1) {++i;}
-            
-            this->bombs[i].update(owner, param2, param1, p);
-            this->bombs[i].id = i;
-            this->bombs[i].previous_bomb = this->lastBomb;
-            this->bombs[i].next_bomb = -1;     
-            
-            this->bombs[this->lastBomb].next_bomb = i;                                    
-            this->lastBomb = i;
-        }              
-    }
-    inline void remove_bomb(const char& bombId){
-        if(this->bombs[bombId].previous_bomb!=-1) {
-            this->bombs[this->bombs[bombId].previous_bomb].next_bomb = this->bombs[bombId].next_bomb;
-        } else{ 
-            this->firstBomb = this->bombs[bombId].next_bomb;
-        }
-        if(this->bombs[bombId].next_bomb!=-1){
-            this->bombs[this->bombs[bombId].next_bomb].previous_bomb = this->bombs[bombId].previous_bomb;        
-        } else {
-            this->lastBomb = this->bombs[bombId].previous_bomb;
+        this->bombSlots[cellIndex(p)] = this->bombNum;
+        Bomb& bomb = this->bombs[this->bombNum++];
+        bomb = Bomb(owner, param2, param1, p);
+        this->rehashBomb(bomb);
+    }
+    // The last bomb takes the freed slot
+    inline void remove_bomb(char bombId){
+        this->rehashBomb(this->bombs[bombId]);
+        --this->bombNum;
+        if (bombId != this->bombNum) {
+            this->bombs[bombId] = this->bombs[this->bombNum];
+            this->bombSlots[this->bombs[bombId].cell] = bombId;
         }
-        this->bombs[this->bombs[bombId].id].id = -1;
-        this->bombs[this->bombs[bombId].id].previous_bomb = -1;    
-        this->bombs[this->bombs[bombId].id].next_bomb = -1;    
     }    
 };
+static_assert(sizeof(Board) <= 8 * 64, "a board fits in a few cache lines");
+
+// 143-bit cell set, bit index = y*GLOBAL_MAX_WIDTH + x
+const int GLOBAL_CELL_NUM = GLOBAL_MAX_WIDTH*GLOBAL_MAX_HEIGHT;
+struct BitMask {
+    uint64_t w[3];
+
+    inline BitMask() = default;
+    inline BitMask(BitMask const&) = default;
+    inline BitMask(BitMask&&) = default;
+    inline BitMask& operator=(BitMask const&) = default;
+    inline BitMask& operator=(BitMask&&) = default;
+
+    constexpr BitMask(uint64_t w0, uint64_t w1, uint64_t w2) : w{w0, w1, w2} {}
+
+    static inline int index(const Point& p) {
+        return p.y * GLOBAL_MAX_WIDTH + p.x;
+    }
+    static inline Point point(int idx) {
+        return Point(idx % GLOBAL_MAX_WIDTH, idx / GLOBAL_MAX_WIDTH);
+    }
+    static inline BitMask cell(int idx) {
+        BitMask res(0, 0, 0);
+        res.set(idx);
+        return res;
+    }
+    inline bool test(int idx) const {
+        return (this->w[idx >> 6] >> (idx & 63)) & 1;
+    }
+    inline void set(int idx) {
+        this->w[idx >> 6] |= 1ULL << (idx & 63);
+    }
+    inline void reset(int idx) {
+        this->w[idx >> 6] &= ~(1ULL << (idx & 63));
+    }
+    inline bool any() const {
+        return (this->w[0] | this->w[1] | this->w[2]) != 0;
+    }
+    inline int first() const {
+        if (this->w[0]) return __builtin_ctzll(this->w[0]);
+        if (this->w[1]) return 64 + __builtin_ctzll(this->w[1]);
+        return 128 + __builtin_ctzll(this->w[2]);
+    }
+    inline int count() const {
+        return __builtin_popcountll(this->w[0]) + __builtin_popcountll(this->w[1]) + __builtin_popcountll(this->w[2]);
+    }
+    // Towards higher indices, 0 < n < 64
+    inline BitMask shl(int n) const {
+        return BitMask(this->w[0] << n,
+                       (this->w[1] << n) | (this->w[0] >> (64 - n)),
+                       (this->w[2] << n) | (this->w[1] >> (64 - n)));
+    }
+    // Towards lower indices, 0 < n < 64
+    inline BitMask shr(int n) const {
+        return BitMask((this->w[0] >> n) | (this->w[1] << (64 - n)),
+                       (this->w[1] >> n) | (this->w[2] << (64 - n)),
+                       this->w[2] >> n);
+    }
+    inline BitMask operator&(const BitMask& m) const {
+        return BitMask(this->w[0] & m.w[0], this->w[1] & m.w[1], this->w[2] & m.w[2]);
+    }
+    inline BitMask operator|(const BitMask& m) const {
+        return BitMask(this->w[0] | m.w[0], this->w[1] | m.w[1], this->w[2] | m.w[2]);
+    }
+    inline BitMask andNot(const BitMask& m) const {
+        return BitMask(this->w[0] & ~m.w[0], this->w[1] & ~m.w[1], this->w[2] & ~m.w[2]);
+    }
+    inline BitMask& operator|=(const BitMask& m) {
+        this->w[0] |= m.w[0];
+        this->w[1] |= m.w[1];
+        this->w[2] |= m.w[2];
+        return *this;
+    }
+    inline BitMask& operator&=(const BitMask& m) {
+        this->w[0] &= m.w[0];
+        this->w[1] &= m.w[1];
+        this->w[2] &= m.w[2];
+        return *this;
+    }
+};
+
+constexpr BitMask bitMaskWithoutColumn(int column) {
+    BitMask res(0, 0, 0);
+    for (int i = 0; i < GLOBAL_CELL_NUM; ++i) {
+        if (column < 0 || i % GLOBAL_MAX_WIDTH != column) {
+            res.w[i >> 6] |= 1ULL << (i & 63);
+        }
+    }
+    return res;
+}
+constexpr BitMask GLOBAL_BITMASK_FULL = bitMaskWithoutColumn(-1);
+constexpr BitMask GLOBAL_BITMASK_NOT_FIRST_COLUMN = bitMaskWithoutColumn(0);
+constexpr BitMask GLOBAL_BITMASK_NOT_LAST_COLUMN = bitMaskWithoutColumn(GLOBAL_MAX_WIDTH-1);
+
+// Move a cell set one step in a direction, same codes as Gene::direction()
+inline BitMask bitMaskStep(const BitMask& m, char direction) {
+    switch (direction) {
+        case 1: return m.shl(1) & GLOBAL_BITMASK_NOT_FIRST_COLUMN;
+        case 2: return m.shl(GLOBAL_MAX_WIDTH) & GLOBAL_BITMASK_FULL;
+        case 3: return m.shr(1) & GLOBAL_BITMASK_NOT_LAST_COLUMN;
+        case 4: return m.shr(GLOBAL_MAX_WIDTH);
+    }
+    return m;
+}
+
+struct BitBomb {
+    char owner;
+    char range;
+    char timer;
+    unsigned char cell;
+};
+
+// Alternative simulator: same rules as Board::update, state stored as cell sets
+struct BitBoard {
+    BitMask walls;
+    BitMask boxes;
+    BitMask boxesRange;
+    BitMask boxesStock;
+    BitMask itemsRange;
+    BitMask itemsStock;
+    BitMask bombCells;
+    Player players [GLOBAL_PLAYER_NUM];
+    BitBomb bombs[GLOBAL_MAX_BOMBS];
+    char bombNum = 0;
+    char playerNum = GLOBAL_PLAYER_NUM;
+    int scores [GLOBAL_PLAYER_NUM];
+
+    inline BitBoard() = default;
+    inline BitBoard(BitBoard const&) = default;
+    inline BitBoard(BitBoard&&) = default;
+    inline BitBoard& operator=(BitBoard const&) = default;
+    inline BitBoard& operator=(BitBoard&&) = default;
 
-Board global_working_board;
+    inline BitBoard(const Board& board) {
+        this->load(board);
+    }
+    inline void load(const Board& board) {
+        this->walls = this->boxes = this->boxesRange = this->boxesStock = BitMask(0, 0, 0);
+        this->itemsRange = this->itemsStock = this->bombCells = BitMask(0, 0, 0);
+        for (char x = 0; x < GLOBAL_MAX_WIDTH; ++x) {
+            for (char y = 0; y < GLOBAL_MAX_HEIGHT; ++y) {
+                int idx = BitMask::index(Point(x, y));
+                switch (board.theBoard[x][y].t) {
+                    case Square::type::wall: this->walls.set(idx); break;
+                    case Square::type::box: this->boxes.set(idx); break;
+                    case Square::type::box_b_range: this->boxesRange.set(idx); break;
+                    case Square::type::box_b_stock: this->boxesStock.set(idx); break;
+                    case Square::type::item_b_range: this->itemsRange.set(idx); break;
+                    case Square::type::item_b_stock: this->itemsStock.set(idx); break;
+                    case Square::type::bomb: this->bombCells.set(idx); break;
+                    default: break;
+                }
+            }
+        }
+        for (char i = 0; i < GLOBAL_PLAYER_NUM; ++i) {
+            this->players[i] = board.players[i];
+            this->scores[i] = board.scores[i];
+        }
+        this->playerNum = board.playerNum;
+        this->bombNum = 0;
+        for (char i = 0; i < board.bombNum; ++i) {
+            BitBomb& b = this->bombs[this->bombNum++];
+            b.owner = board.bombs[i].owner;
+            b.range = board.bombs[i].range;
+            b.timer = board.bombs[i].timer;
+            b.cell = BitMask::index(board.bombs[i].point());
+        }
+    }
+    inline BitMask allBoxes() const {
+        return this->boxes | this->boxesRange | this->boxesStock;
+    }
+    // Everything but empty squares stops a blast
+    inline BitMask blockers() const {
+        return this->walls | this->allBoxes() | this->itemsRange | this->itemsStock | this->bombCells;
+    }
+    inline bool canEnter(int idx) const {
+        return !(this->walls | this->allBoxes() | this->bombCells).test(idx);
+    }
+    inline BitMask playerCells() const {
+        BitMask res(0, 0, 0);
+        for (char i = 0; i < GLOBAL_PLAYER_NUM; ++i) {
+            if (this->players[i].isAlive) {
+                res.set(BitMask::index(this->players[i].p));
+            }
+        }
+        return res;
+    }
+    inline void killPlayersIn(const BitMask& area) {
+        for (char i = 0; i < GLOBAL_PLAYER_NUM; ++i) {
+            if (area.test(BitMask::index(this->players[i].p))) {
+                this->players[i].kill();
+            }
+        }
+    }
+    // Returns the exploded cells, boxes are left in place and reported in deleteBox
+    inline BitMask bigBadaboum(BitMask& deleteBox) {
+        for (char i = 0; i < this->bombNum; ++i) {
+            --this->bombs[i].timer;
+        }
+        return this->explode(deleteBox);
+    }
+    // Bombs whose timer ran out explode, with chain reactions
+    inline BitMask explode(BitMask& deleteBox) {
+        BitMask blast(0, 0, 0);
+        const BitMask occupied = this->playerCells();
+        const BitMask stop = this->blockers();
+        const BitMask destroyable = (stop.andNot(this->walls)) | occupied;
+        const BitMask boxCells = this->allBoxes();
+        unsigned char explosionList[GLOBAL_MAX_BOMBS];
+        char first = 0;
+        char next = 0;
+        for (char i = 0; i < this->bombNum; ++i) {
+            if (this->bombs[i].timer <= 0) {
+                explosionList[next++] = i;
+            }
+        }
+        while (first != next) {
+            const BitBomb& b = this->bombs[explosionList[first++]];
+            for (char d = 1; d <= 4; ++d) {
+                BitMask cur = BitMask::cell(b.cell);
+                for (char k = 1; k < b.range; ++k) {
+                    cur = bitMaskStep(cur, d);
+                    if (!cur.any()) {
+                        break;
+                    }
+                    blast |= cur & destroyable;
+                    if ((cur & stop).any()) {
+                        if ((cur & this->bombCells).any()) {
+                            int hit = cur.first();
+                            for (char j = 0; j < this->bombNum; ++j) {
+                                if (this->bombs[j].cell == hit && this->bombs[j].timer > 0) {
+                                    this->bombs[j].timer = 0;
+                                    explosionList[next++] = j;
+                                }
+                            }
+                        }
+                        if ((cur & boxCells).any()) {
+                            this->players[b.owner].increaseScore();
+                        }
+                        break;
+                    }
+                }
+            }
+            ++this->players[b.owner].reloading_stock;
+            blast.set(b.cell);
+        }
+        this->killPlayersIn(blast & occupied);
+        // Remove exploded bombs
+        char kept = 0;
+        for (char i = 0; i < this->bombNum; ++i) {
+            if (this->bombs[i].timer > 0) {
+                this->bombs[kept++] = this->bombs[i];
+            }
+        }
+        this->bombNum = kept;
+        deleteBox = blast & boxCells;
+        this->itemsRange = this->itemsRange.andNot(blast);
+        this->itemsStock = this->itemsStock.andNot(blast);
+        this->bombCells = this->bombCells.andNot(blast);
+        return blast;
+    }
+    inline int getNext(const Gene& g, const Player& player) const {
+        int idx = BitMask::index(player.p);
+        char d = g.direction();
+        if (d == 0) {
+            return idx;
+        }
+        BitMask next = bitMaskStep(BitMask::cell(idx), d);
+        if (!next.any() || !this->canEnter(next.first())) {
+            return idx;
+        }
+        return next.first();
+    }
+    inline void update(const Gene genes[GLOBAL_PLAYER_NUM], int multiplier, const ScoreWeights& weights) {
+        forPlayerNum(this->playerNum, [&](auto players) {
+            this->updateFor<decltype(players)::value>(genes, multiplier, weights);
+        });
+    }
+    template <char P>
+    inline void updateFor(const Gene genes[GLOBAL_PLAYER_NUM], int multiplier, const ScoreWeights& weights) {
+        int temp_score[GLOBAL_PLAYER_NUM];
+        int newPositions[GLOBAL_PLAYER_NUM];
+        BitMask deleteBox;
+        for (char i = 0; i < P; ++i) {
+            temp_score[i] = this->players[i].score;
+        }
+        this->bigBadaboum(deleteBox);
+        for (char i = 0; i < P; ++i) {
+            if (this->players[i].isAlive) {
+                newPositions[i] = this->getNext(genes[i], this->players[i]);
+            }
+        }
+        for (char i = 0; i < P; ++i) {
+            Player& player = this->players[i];
+            if (!player.isAlive) {
+                this->scores[i] = INT_MIN;
+                continue;
+            }
+            int idx = BitMask::index(player.p);
+            if (genes[i].bomb() && player.cur_stock > 0 && !this->bombCells.test(idx) && this->bombNum < GLOBAL_MAX_BOMBS) {
+                --player.cur_stock;
+                BitBomb& b = this->bombs[this->bombNum++];
+                b.owner = i;
+                b.range = player.range;
+                b.timer = 8;
+                b.cell = idx;
+                this->bombCells.set(idx);
+                this->scores[i] += weights.bomb;
+            }
+            this->scores[i] += (player.score - temp_score[i]) * multiplier * weights.box;
+            if (newPositions[i] != idx) {
+                if (this->canEnter(newPositions[i])) {
+                    if (this->itemsRange.test(newPositions[i])) {
+                        ++player.range;
+                        this->scores[i] += weights.rangeItem * multiplier;
+                        this->itemsRange.reset(newPositions[i]);
+                    } else if (this->itemsStock.test(newPositions[i])) {
+                        if (player.cur_stock < weights.stockCap) this->scores[i] += weights.stockItem * multiplier;
+                        ++player.cur_stock;
+                        this->itemsStock.reset(newPositions[i]);
+                    }
+                    player.p = BitMask::point(newPositions[i]);
+                }
+            } else {
+                this->scores[i] += weights.stay;
+            }
+            player.reload();
+        }
+        this->boxes = this->boxes.andNot(deleteBox);
+        this->boxesRange = this->boxesRange.andNot(deleteBox);
+        this->boxesStock = this->boxesStock.andNot(deleteBox);
+    }
+};
 
-char g_genome_i;
+// GLOBAL_GENOME_SIZE genes of 4 bits, gene i in bits 4*i..4*i+3
 struct Genome {
     int score = INT_MIN;
-    Gene array[GLOBAL_GENOME_SIZE];
+    uint64_t genes = 0;
     inline Genome() = default;
     inline Genome(Genome const&) = default;
     inline Genome(Genome&&) = default;
@@ -911,217 +1414,2237 @@ struct Genome {
             return false;
         }
     }
+    inline Gene gene(char i) const {
+        return Gene((unsigned char)((this->genes >> (4*i)) & 0xF));
+    }
+    inline void setGene(char i, const Gene& g) {
+        this->genes = (this->genes & ~(uint64_t(0xF) << (4*i))) | uint64_t(g.action) << (4*i);
+    }
     inline string toString() const {
         string res = "";
         for (int i =0;i<GLOBAL_GENOME_SIZE;++i){
-            res += this->array[i].toString() + "\n";
+            res += this->gene(i).toString() + "\n";
+        }
+        return res;
+    }
+    // Every nibble a uniform action
+    static inline uint64_t randomGenes(Rng& rng) {
+        uint64_t res = 0;
+        for (char i=0; i<GLOBAL_GENOME_SIZE; i+=2) {
+            const uint32_t r = rng.next();
+            res |= uint64_t(Gene::random(r) | (Gene::random(r >> 16) << 4)) << (4*i);
         }
         return res;
     }
-    inline void nextGen(){
-        for(g_genome_i=0;g_genome_i<GLOBAL_GENOME_SIZE-1;++g_genome_i){
-            this->array[g_genome_i] = this->array[g_genome_i+1] ;
+    // One random bit per gene spread over its nibble
+    static inline uint64_t randomMask(Rng& rng) {
+        const uint64_t high = rng.next();
+        const uint64_t low = rng.next();
+        return ((high << 32 | low) & GLOBAL_GENOME_NIBBLE_LOW) * 0xF;
+    }
+    // Same, each gene being set with probability p, from one random byte per gene
+    static inline uint64_t randomMask(Rng& rng, float p) {
+        const uint32_t threshold = p * 256;
+        uint64_t res = 0;
+        for (char i = 0; i < GLOBAL_GENOME_SIZE; i += 4) {
+            const uint32_t r = rng.next();
+            for (char j = 0; j < 4 && i + j < GLOBAL_GENOME_SIZE; ++j) {
+                res |= uint64_t(((r >> (8*j)) & 0xFF) < threshold) << (4*(i+j));
+            }
         }
-        this->array[GLOBAL_GENOME_SIZE-1] = Gene();
+        return res * 0xF;
     }
-    inline void cross(const Genome& g1, const Genome& g2) {        
-        for (g_genome_i=0; g_genome_i<GLOBAL_GENOME_SIZE; ++g_genome_i) {
-            this->array[g_genome_i].cross(g1.array[g_genome_i],g2.array[g_genome_i]);
-        }        
+    inline void randomize(Rng& rng) {
+        this->genes = Genome::randomGenes(rng);
+    }
+    inline void nextGen(Rng& rng){
+        this->genes = (this->genes >> 4) | (uint64_t(Gene(rng).action) << (4*(GLOBAL_GENOME_SIZE-1)));
+    }
+    // Each gene from g2 with probability bias, else from g1, then replaced by a random one with probability rate
+    inline void cross(const Genome& g1, const Genome& g2, Rng& rng, float bias, float rate) {
+        const uint64_t parent = Genome::randomMask(rng, bias);
+        const uint64_t fresh = Genome::randomMask(rng, rate);
+        this->genes = (g1.genes & ~parent) | (g2.genes & parent);
+        this->genes = (this->genes & ~fresh) | (Genome::randomGenes(rng) & fresh);
     }    
-    inline void mutate(const Genome& g1) {        
-        for (g_genome_i=0; g_genome_i<GLOBAL_GENOME_SIZE; ++g_genome_i) {
-            this->array[g_genome_i].mutate(g1.array[g_genome_i]);            
-        }        
+    // Each gene flips its bomb 1 time in 4, 1 in 16 replaced by a random one
+    inline void mutate(const Genome& g1, Rng& rng) {        
+        // Masks are drawn one statement at a time so the rng sequence does not depend on evaluation order
+        uint64_t flip = Genome::randomMask(rng);
+        flip &= Genome::randomMask(rng);
+        flip &= GLOBAL_GENOME_NIBBLE_LOW << 3;
+        uint64_t fresh = Genome::randomMask(rng);
+        for (char i = 0; i < 3; ++i) {
+            fresh &= Genome::randomMask(rng);
+        }
+        this->genes = g1.genes ^ flip;
+        this->genes = (this->genes & ~fresh) | (Genome::randomGenes(rng) & fresh);
     }    
 };
 
-char g_Top10Genome_i;
-char g_Top10Genome_best;
-
-char g_Top10Genome_index;
-struct Top10Genome {
-    Genome array[10];  
-    char minIt = 0;
-    inline Top10Genome() = default;
-    inline Top10Genome(Top10Genome const&) = default;
-    inline Top10Genome(Top10Genome&&) = default;
-    inline Top10Genome& operator=(Top10Genome const&) = default;
-    inline Top10Genome& operator=(Top10Genome&&) = default;         
-        
-    inline void addSup(const Genome& g) {
-        if( this->array[this->minIt] < g ){            
-            this->array[this->minIt] = g;            
-            for(g_Top10Genome_i=0;g_Top10Genome_i<10;++g_Top10Genome_i){
-                if(this->array[g_Top10Genome_i] < this->array[this->minIt]){
-                    this->minIt = g_Top10Genome_i;
-                }                
-            }
-        }        
-    }    
-    // inline void addSup(const Genome& g) {
-    //     g_Top10Genome_index = g.array[0].getType();
-    //     if( this->array[g_Top10Genome_index] < g ){            
-    //         this->array[g_Top10Genome_index] = g;                        
-    //     }        
-    // }    
-    inline Genome top() {
-        g_Top10Genome_best = 0;
-        for(g_Top10Genome_i=1;g_Top10Genome_i<10;++g_Top10Genome_i){
-            if(this->array[g_Top10Genome_best] < this->array[g_Top10Genome_i]){
-                g_Top10Genome_best = g_Top10Genome_i;
-            }                
+// Most genomes kept per player, SearchConfig::eliteSize sets how many are kept.
+// They are also the crossover parents of the next generation.
+const uint GLOBAL_MAX_ELITE_SIZE = 127;
+static_assert(GLOBAL_MAX_ELITE_SIZE <= 127, "elite indexes are stored in a char");
+// Most candidates and opponents played against each other by findBestFullGenome. It stays
+// fixed whatever eliteSize: the matchups cost its square in rollouts, taken from the time
+// left after evolve, and the elites past the first ranks are rarely the best.
+const uint GLOBAL_BEST_MATCHUPS = 10;
+
+// Best capacity distinct genomes, at most K: a min-heap on the score, with a linear probing
+// index from the genes to the heap position so that a clone only raises the score of its entry
+template <uint K>
+struct TopGenomes {
+    static constexpr uint BITS = K <= 4 ? 3 : 32 - __builtin_clz(2*K - 1);
+    static constexpr uint SLOTS = 1 << BITS;
+    Genome heap [K];
+    short slot [K]; // index slot of each heap entry
+    short index [SLOTS]; // heap position, -1 when free
+    uint size = 0;
+    uint capacity = K;
+    Genome best;
+
+    inline TopGenomes(uint capacity = K) : capacity(min(capacity, K)) {
+        for (uint s = 0; s < SLOTS; ++s) {
+            this->index[s] = -1;
         }
-        return this->array[g_Top10Genome_best];
     }
-};
+    inline TopGenomes(TopGenomes const&) = default;
+    inline TopGenomes(TopGenomes&&) = default;
+    inline TopGenomes& operator=(TopGenomes const&) = default;
+    inline TopGenomes& operator=(TopGenomes&&) = default;
 
-char g_FullGenome_i;
-struct FullGenome {
-    Genome array[GLOBAL_PLAYER_NUM];
-    inline FullGenome() = default;
-    inline FullGenome(FullGenome const&) = default;
-    inline FullGenome(FullGenome&&) = default;
-    inline FullGenome& operator=(FullGenome const&) = default;
-    inline FullGenome& operator=(FullGenome&&) = default;     
-    
-    inline FullGenome(const Genome& g1,const Genome& g2,const Genome& g3,const Genome& g4) {
-        this->array[0] = g1;
-        this->array[1] = g2;
-        this->array[2] = g3;
-        this->array[3] = g4;
+    static inline uint home(uint64_t genes) {
+        return (genes * 0x9E3779B97F4A7C15ULL) >> (64 - BITS);
     }
-    
+    inline int find(uint64_t genes) const {
+        for (uint s = home(genes); this->index[s] != -1; s = (s + 1) & (SLOTS - 1)) {
+            if (this->heap[this->index[s]].genes == genes) {
+                return s;
+            }
+        }
+        return -1;
+    }
+    inline void link(uint pos) {
+        uint s = home(this->heap[pos].genes);
+        while (this->index[s] != -1) {
+            s = (s + 1) & (SLOTS - 1);
+        }
+        this->index[s] = pos;
+        this->slot[pos] = s;
+    }
+    // Backward shift deletion keeps every probe sequence without holes
+    inline void unlink(uint pos) {
+        uint hole = this->slot[pos];
+        this->index[hole] = -1;
+        for (uint s = (hole + 1) & (SLOTS - 1); this->index[s] != -1; s = (s + 1) & (SLOTS - 1)) {
+            const uint h = home(this->heap[this->index[s]].genes);
+            if (((s - h) & (SLOTS - 1)) >= ((s - hole) & (SLOTS - 1))) {
+                this->index[hole] = this->index[s];
+                this->slot[this->index[hole]] = hole;
+                this->index[s] = -1;
+                hole = s;
+            }
+        }
+    }
+    inline void exchange(uint a, uint b) {
+        swap(this->heap[a], this->heap[b]);
+        swap(this->slot[a], this->slot[b]);
+        this->index[this->slot[a]] = a;
+        this->index[this->slot[b]] = b;
+    }
+    inline void siftUp(uint pos) {
+        while (pos > 0 && this->heap[pos] < this->heap[(pos - 1) / 2]) {
+            this->exchange(pos, (pos - 1) / 2);
+            pos = (pos - 1) / 2;
+        }
+    }
+    inline void siftDown(uint pos) {
+        for (uint child = 2 * pos + 1; child < this->size; pos = child, child = 2 * pos + 1) {
+            if (child + 1 < this->size && this->heap[child + 1] < this->heap[child]) {
+                ++child;
+            }
+            if (!(this->heap[child] < this->heap[pos])) {
+                return;
+            }
+            this->exchange(pos, child);
+        }
+    }
+    inline void addSup(const Genome& g) {
+        // Not above the minimum: neither a new entry nor a better score for a clone
+        if (this->size == this->capacity && !(this->heap[0] < g)) {
+            return;
+        }
+        if (this->size == 0 || this->best < g) {
+            this->best = g;
+        }
+        const int s = this->find(g.genes);
+        if (s != -1) {
+            const uint pos = this->index[s];
+            if (this->heap[pos] < g) {
+                this->heap[pos].score = g.score;
+                this->siftDown(pos);
+            }
+            return;
+        }
+        if (this->size < this->capacity) {
+            this->heap[this->size] = g;
+            this->link(this->size);
+            this->siftUp(this->size++);
+        } else if (this->heap[0] < g) {
+            this->unlink(0);
+            this->heap[0] = g;
+            this->link(0);
+            this->siftDown(0);
+        }
+    }
+    inline Genome top() const {
+        return this->best;
+    }
+    // Best first, missing entries are still genomes without score
+    inline void sorted(Genome out[K]) const {
+        copy(this->heap, this->heap + this->size, out);
+        sort(out, out + this->size, [](const Genome& a, const Genome& b) { return b < a; });
+        fill(out + this->size, out + K, Genome());
+    }
+};
+typedef TopGenomes<GLOBAL_MAX_ELITE_SIZE> EliteGenomes;
+
+struct FullGenome {
+    Genome array[GLOBAL_PLAYER_NUM];
+    inline FullGenome() = default;
+    inline FullGenome(Rng& rng) {
+        for(char i = 0; i<GLOBAL_PLAYER_NUM;++i){
+            this->array[i].randomize(rng);
+        }
+    }
+    inline FullGenome(FullGenome const&) = default;
+    inline FullGenome(FullGenome&&) = default;
+    inline FullGenome& operator=(FullGenome const&) = default;
+    inline FullGenome& operator=(FullGenome&&) = default;     
+    
+    inline FullGenome(const Genome& g1,const Genome& g2,const Genome& g3,const Genome& g4) {
+        this->array[0] = g1;
+        this->array[1] = g2;
+        this->array[2] = g3;
+        this->array[3] = g4;
+    }
+    
     inline void update(const int& id,const Genome& g) {
         this->array[id] = g;
     }
-    inline void genes(const int& id, Gene gArray[GLOBAL_PLAYER_NUM]){        
-        for(g_FullGenome_i = 0; g_FullGenome_i<GLOBAL_PLAYER_NUM;++g_FullGenome_i){
-            gArray[g_FullGenome_i]= this->array[g_FullGenome_i].array[id];
+    // Players [P, GLOBAL_PLAYER_NUM) are left untouched
+    template <char P = GLOBAL_PLAYER_NUM>
+    inline void randomize(Rng& rng) {
+        for(char i = 0; i<P;++i){
+            this->array[i].randomize(rng);
+        }
+    }
+    template <char P = GLOBAL_PLAYER_NUM>
+    inline void genes(const int& id, Gene gArray[GLOBAL_PLAYER_NUM]) const {        
+        for(char i = 0; i<P;++i){
+            gArray[i]= this->array[i].gene(id);
         }        
     }
     
-    inline void nextGen(){
-        for(g_FullGenome_i=0;g_FullGenome_i<GLOBAL_PLAYER_NUM;++g_FullGenome_i){
-            this->array[g_FullGenome_i].nextGen();
+    template <char P = GLOBAL_PLAYER_NUM>
+    inline void nextGen(Rng& rng){
+        for(char i=0;i<P;++i){
+            this->array[i].nextGen(rng);
+        }
+    }
+    template <char P = GLOBAL_PLAYER_NUM>
+    inline void cross(const FullGenome& g1, const FullGenome& g2, Rng& rng, float bias, float rate){
+        for(char i=0;i<P;++i){
+            this->array[i].cross(g1.array[i],g2.array[i],rng,bias,rate);
+        }
+    }
+    template <char P = GLOBAL_PLAYER_NUM>
+    inline void mutate(const FullGenome& g1, Rng& rng){
+        for(char i=0;i<P;++i){
+            this->array[i].mutate(g1.array[i],rng);
+        }
+    }
+};
+
+const char GLOBAL_DANGER_REDRAWS = 4; // random genomes drawn before keeping a doomed one
+
+// Squares hit during each rollout step by the bombs already on the board,
+// chain reactions included, and the squares that cannot be entered at that
+// step. Bombs dropped during the rollout are not known here.
+struct DangerMap {
+    BitMask blast [GLOBAL_GENOME_SIZE];
+    BitMask blocked [GLOBAL_GENOME_SIZE];
+
+    inline void build(const Board& root) {
+        Board board = root;
+        SimScratch scratch;
+        for (char t = 0; t < GLOBAL_GENOME_SIZE; ++t) {
+            const Board previous = board;
+            scratch.deleteBox.setEmpty();
+            board.bigBadaboum(scratch);
+            // The bombs that left the list went off together, their rays are walked on the board before
+            this->blast[t] = BitMask(0, 0, 0);
+            const Square* squares = &(previous.theBoard[0][0]);
+            for (char i = 0; i < previous.bombNum; ++i) {
+                const Bomb& bomb = previous.bombs[i];
+                if (board.bombAt(bomb.cell) != -1) {
+                    continue;
+                }
+                const int origin = bomb.cell;
+                this->blast[t].set(BitMask::index(bomb.point()));
+                for (char d = 0; d < 4; ++d) {
+                    const char length = min<char>(bomb.range - 1, GLOBAL_BLAST_RAYS.length[origin][d]);
+                    for (char k = 0; k < length; ++k) {
+                        const int cell = GLOBAL_BLAST_RAYS.cells[origin][d][k];
+                        const Square& square = squares[cell];
+                        this->blast[t].set(BitMask::index(cellPoint(cell)));
+                        if (square.blocksExplosion()) {
+                            break;
+                        }
+                    }
+                }
+            }
+            // Moves are checked before the destroyed boxes are cleaned
+            this->blocked[t] = BitMask(0, 0, 0);
+            for (char x = 0; x < GLOBAL_MAX_WIDTH; ++x) {
+                for (char y = 0; y < GLOBAL_MAX_HEIGHT; ++y) {
+                    if (!board.theBoard[x][y].canEnter()) {
+                        this->blocked[t].set(BitMask::index(Point(x, y)));
+                    }
+                }
+            }
+            while (!scratch.deleteBox.empty()) {
+                scratch.deleteBox.front_and_pop()->explose();
+            }
+        }
+    }
+    // First step at which a player starting on start and playing genome stands in a blast,
+    // GLOBAL_GENOME_SIZE if none
+    inline char doomedAt(const Genome& genome, const Point& start) const {
+        Point p = start;
+        for (char t = 0; t < GLOBAL_GENOME_SIZE; ++t) {
+            if (this->blast[t].test(BitMask::index(p))) {
+                return t;
+            }
+            const char d = genome.gene(t).direction();
+            const Point next(p.x + GLOBAL_DIRECTION_DX[d], p.y + GLOBAL_DIRECTION_DY[d]);
+            if (next.isInside() && !this->blocked[t].test(BitMask::index(next))) {
+                p = next;
+            }
+        }
+        return GLOBAL_GENOME_SIZE;
+    }
+    // Whether some sequence of moves from start avoids every known blast
+    inline bool canEscape(const Point& start) const {
+        BitMask reached = BitMask::cell(BitMask::index(start));
+        for (char t = 0; t < GLOBAL_GENOME_SIZE; ++t) {
+            reached = reached.andNot(this->blast[t]);
+            if (!reached.any()) {
+                return false;
+            }
+            BitMask next = reached;
+            for (int idx = 0; idx < GLOBAL_MAX_WIDTH*GLOBAL_MAX_HEIGHT; ++idx) {
+                if (!reached.test(idx)) {
+                    continue;
+                }
+                const Point p = BitMask::point(idx);
+                for (char d = 1; d < 5; ++d) {
+                    const Point n(p.x + GLOBAL_DIRECTION_DX[d], p.y + GLOBAL_DIRECTION_DY[d]);
+                    if (n.isInside() && !this->blocked[t].test(BitMask::index(n))) {
+                        next.set(BitMask::index(n));
+                    }
+                }
+            }
+            reached = next;
+        }
+        return true;
+    }
+};
+
+const char GLOBAL_LEAF_NONE = 0; // a rollout is worth the rewards of its steps
+const char GLOBAL_LEAF_DISTANCE = 1; // plus the DistanceMap and the bombs still ticking when it stops
+const unsigned char GLOBAL_DISTANCE_UNREACHABLE = 255;
+const char GLOBAL_SPOT_MAX_BOXES = 4; // a blast stops at the first box of each ray
+const char GLOBAL_LEAF_ESCAPE = 4; // steps searched for a way out of the blasts
+
+const double GLOBAL_CONFIG_MAX_GENERATIONS = 1e9;
+const double GLOBAL_CONFIG_MAX_WEIGHT = 1 << 16; // a score sums a few weights per step
+const double GLOBAL_CONFIG_MAX_TT_BITS = 28;
+
+// Parameters of the search, the defaults are those of the submitted bot. A profile of
+// key=value lines read by --config=<path> overrides them, # starts a comment.
+struct SearchConfig {
+    uint populationSize = GLOBAL_POPULATION_SIZE; // genomes per generation, at most GLOBAL_POPULATION_SIZE
+    uint eliteSize = 10; // genomes kept per player, less than populationSize
+    uint maxGenerations = 0; // per turn, 0 until the clock runs out
+    float randomShare = 0.5; // of each generation drawn at random, after the elites
+    float crossoverBias = 0.5; // chance that a gene of a child comes from its second parent
+    float mutationRate = 0.125; // chance that a gene of a child is drawn at random instead
+    char depth = GLOBAL_GENOME_SIZE; // rollout steps, the genomes keep GLOBAL_GENOME_SIZE genes
+    char leaf = GLOBAL_LEAF_NONE; // how the state a rollout stops at is scored
+    ScoreWeights weights;
+    // How rollouts are simulated, the search is the same whichever are set
+    bool bitboard = false; // rollouts from the root on a BitBoard
+    bool undo = false; // rewind the worker board instead of copying the root
+    bool checkpoints = false; // children resume from the boards of their parents
+    bool dangerMap = false; // redraw random genomes walking into a known blast
+    bool batch = false; // BatchSim lanes, when the CPU has AVX2
+    char ttBits = 0; // log2 of the transposition table size, 0 disables hashing
+
+    // f(name, field, min, max) on every parameter, C being SearchConfig or const SearchConfig
+    template <typename C, typename F>
+    static inline void fields(C& config, F&& f) {
+        f("populationSize", config.populationSize, 2, GLOBAL_POPULATION_SIZE);
+        f("eliteSize", config.eliteSize, 1, GLOBAL_MAX_ELITE_SIZE);
+        f("maxGenerations", config.maxGenerations, 0, GLOBAL_CONFIG_MAX_GENERATIONS);
+        f("randomShare", config.randomShare, 0, 1);
+        f("crossoverBias", config.crossoverBias, 0, 1);
+        f("mutationRate", config.mutationRate, 0, 1);
+        f("depth", config.depth, 1, GLOBAL_GENOME_SIZE);
+        f("leaf", config.leaf, GLOBAL_LEAF_NONE, GLOBAL_LEAF_DISTANCE);
+        f("weights.box", config.weights.box, -GLOBAL_CONFIG_MAX_WEIGHT, GLOBAL_CONFIG_MAX_WEIGHT);
+        f("weights.rangeItem", config.weights.rangeItem, -GLOBAL_CONFIG_MAX_WEIGHT, GLOBAL_CONFIG_MAX_WEIGHT);
+        f("weights.stockItem", config.weights.stockItem, -GLOBAL_CONFIG_MAX_WEIGHT, GLOBAL_CONFIG_MAX_WEIGHT);
+        f("weights.stockCap", config.weights.stockCap, -GLOBAL_CONFIG_MAX_WEIGHT, GLOBAL_CONFIG_MAX_WEIGHT);
+        f("weights.bomb", config.weights.bomb, -GLOBAL_CONFIG_MAX_WEIGHT, GLOBAL_CONFIG_MAX_WEIGHT);
+        f("weights.stay", config.weights.stay, -GLOBAL_CONFIG_MAX_WEIGHT, GLOBAL_CONFIG_MAX_WEIGHT);
+        f("weights.leafSpotBox", config.weights.leafSpotBox, -GLOBAL_CONFIG_MAX_WEIGHT, GLOBAL_CONFIG_MAX_WEIGHT);
+        f("weights.leafSpotStep", config.weights.leafSpotStep, -GLOBAL_CONFIG_MAX_WEIGHT, GLOBAL_CONFIG_MAX_WEIGHT);
+        f("weights.leafItemStep", config.weights.leafItemStep, -GLOBAL_CONFIG_MAX_WEIGHT, GLOBAL_CONFIG_MAX_WEIGHT);
+        f("weights.leafEscapeStep", config.weights.leafEscapeStep, -GLOBAL_CONFIG_MAX_WEIGHT, GLOBAL_CONFIG_MAX_WEIGHT);
+        f("weights.leafTrapped", config.weights.leafTrapped, -GLOBAL_CONFIG_MAX_WEIGHT, GLOBAL_CONFIG_MAX_WEIGHT);
+        f("bitboard", config.bitboard, 0, 1);
+        f("undo", config.undo, 0, 1);
+        f("checkpoints", config.checkpoints, 0, 1);
+        f("dangerMap", config.dangerMap, 0, 1);
+        f("batch", config.batch, 0, 1);
+        f("ttBits", config.ttBits, 0, GLOBAL_CONFIG_MAX_TT_BITS);
+    }
+    // False for an unknown key or a value that is not a finite number. The value is
+    // clamped to the range of its field before it is converted to the field type.
+    inline bool set(const string& key, const string& value) {
+        char* end = NULL;
+        const double number = strtod(value.c_str(), &end);
+        if (value.empty() || *end != 0 || !isfinite(number)) {
+            return false;
+        }
+        bool found = false;
+        fields(*this, [&](const char* name, auto& field, double lo, double hi) {
+            if (key == name) {
+                field = typename remove_reference<decltype(field)>::type(min(hi, max(lo, number)));
+                found = true;
+            }
+        });
+        return found;
+    }
+    static inline string trimmed(const string& s) {
+        const size_t first = s.find_first_not_of(" \t\r");
+        if (first == string::npos) {
+            return "";
+        }
+        return s.substr(first, s.find_last_not_of(" \t\r") - first + 1);
+    }
+    inline bool load(const string& path) {
+        ifstream in(path);
+        if (!in) {
+            cerr << "Cannot open " << path << endl;
+            return false;
+        }
+        string line;
+        for (int number = 1; getline(in, line); ++number) {
+            line = trimmed(line.substr(0, line.find('#')));
+            if (line.empty()) {
+                continue;
+            }
+            const size_t equal = line.find('=');
+            if (equal == string::npos || !this->set(trimmed(line.substr(0, equal)), trimmed(line.substr(equal + 1)))) {
+                cerr << path << ":" << number << ": cannot read " << line << endl;
+                return false;
+            }
+        }
+        return true;
+    }
+    // A profile load() reads back
+    inline string toString() const {
+        string res;
+        fields(*this, [&](const char* name, const auto& field, double, double) {
+            res += string(name) + "=" + to_string(field) + "\n";
+        });
+        return res;
+    }
+};
+SearchConfig global_config;
+
+// Walking distances on the root board, in steps. Walls and boxes are the only
+// obstacles, the bombs are gone before long. Built once per turn.
+struct DistanceMap {
+    BitMask open;
+    // spot[k][h]: to the closest square where a bomb of player k hits more than h boxes
+    unsigned char spot [GLOBAL_PLAYER_NUM][GLOBAL_SPOT_MAX_BOXES][GLOBAL_CELL_NUM];
+    unsigned char item [GLOBAL_CELL_NUM]; // to the closest item
+
+    // Boxes hit by a bomb of the given range dropped on p
+    static inline char boxesHit(const Board& board, const Point& p, char range) {
+        const Square* squares = &(board.theBoard[0][0]);
+        const int origin = GLOBAL_BLAST_RAYS.index(p);
+        char res = 0;
+        for (char d = 0; d < 4; ++d) {
+            const char length = min<char>(range - 1, GLOBAL_BLAST_RAYS.length[origin][d]);
+            for (char k = 0; k < length; ++k) {
+                const Square& square = squares[GLOBAL_BLAST_RAYS.cells[origin][d][k]];
+                if (square.blocksExplosion()) {
+                    res += square.isBox();
+                    break;
+                }
+            }
+        }
+        return res;
+    }
+    // Breadth first search over the open squares from all the sources at once
+    inline void search(const BitMask& sources, unsigned char dist [GLOBAL_CELL_NUM]) const {
+        myQueue<unsigned char> queue;
+        fill(dist, dist + GLOBAL_CELL_NUM, GLOBAL_DISTANCE_UNREACHABLE);
+        for (int idx = 0; idx < GLOBAL_CELL_NUM; ++idx) {
+            if (sources.test(idx)) {
+                dist[idx] = 0;
+                queue.push(idx);
+            }
+        }
+        while (!queue.empty()) {
+            const unsigned char cur = queue.front_and_pop();
+            const Point p = BitMask::point(cur);
+            for (char d = 1; d < 5; ++d) {
+                const Point n(p.x + GLOBAL_DIRECTION_DX[d], p.y + GLOBAL_DIRECTION_DY[d]);
+                if (!n.isInside()) {
+                    continue;
+                }
+                const int idx = BitMask::index(n);
+                if (this->open.test(idx) && dist[idx] == GLOBAL_DISTANCE_UNREACHABLE) {
+                    dist[idx] = dist[cur] + 1;
+                    queue.push(idx);
+                }
+            }
+        }
+    }
+    inline void build(const Board& root) {
+        BitMask items(0, 0, 0);
+        this->open = BitMask(0, 0, 0);
+        for (char x = 0; x < GLOBAL_MAX_WIDTH; ++x) {
+            for (char y = 0; y < GLOBAL_MAX_HEIGHT; ++y) {
+                const Square& square = root.theBoard[x][y];
+                if (square.t != Square::type::wall && !square.isBox()) {
+                    this->open.set(BitMask::index(Point(x, y)));
+                }
+                if (square.t == Square::type::item_b_range || square.t == Square::type::item_b_stock) {
+                    items.set(BitMask::index(Point(x, y)));
+                }
+            }
+        }
+        this->search(items, this->item);
+        for (char k = 0; k < root.playerNum; ++k) {
+            BitMask spots [GLOBAL_SPOT_MAX_BOXES];
+            for (char h = 0; h < GLOBAL_SPOT_MAX_BOXES; ++h) {
+                spots[h] = BitMask(0, 0, 0);
+            }
+            for (int idx = 0; idx < GLOBAL_CELL_NUM; ++idx) {
+                if (this->open.test(idx)) {
+                    const char hit = boxesHit(root, BitMask::point(idx), root.players[k].range);
+                    for (char h = 0; h < hit; ++h) {
+                        spots[h].set(idx);
+                    }
+                }
+            }
+            for (char h = 0; h < GLOBAL_SPOT_MAX_BOXES; ++h) {
+                this->search(spots[h], this->spot[k][h]);
+            }
+        }
+    }
+};
+
+// Scores the state a rollout stops at, so that a horizon shorter than the genomes does
+// not lose what the steps after it would bring: the boxes of the bombs still ticking,
+// credited as if the rollout had gone on, the bombing spots and items in reach, and
+// the way out of the coming blasts.
+struct LeafEvaluator {
+    char kind = GLOBAL_LEAF_NONE;
+    char depth = GLOBAL_GENOME_SIZE;
+    ScoreWeights weights;
+    DistanceMap distances;
+    int value [GLOBAL_PLAYER_NUM][GLOBAL_CELL_NUM]; // what the distances are worth, per player and square
+
+    inline void build(const Board& root, const SearchConfig& config) {
+        this->kind = config.leaf;
+        this->depth = config.depth;
+        this->weights = config.weights;
+        if (this->kind == GLOBAL_LEAF_NONE) {
+            return;
+        }
+        const ScoreWeights& weights = config.weights;
+        this->distances.build(root);
+        for (char k = 0; k < root.playerNum; ++k) {
+            for (int idx = 0; idx < GLOBAL_CELL_NUM; ++idx) {
+                int spot = 0;
+                for (char h = 0; h < GLOBAL_SPOT_MAX_BOXES; ++h) {
+                    const unsigned char d = this->distances.spot[k][h][idx];
+                    if (d != GLOBAL_DISTANCE_UNREACHABLE) {
+                        spot = max(spot, weights.leafSpotBox * (h + 1) - weights.leafSpotStep * d);
+                    }
+                }
+                const unsigned char item = this->distances.item[idx];
+                this->value[k][idx] = spot - (item != GLOBAL_DISTANCE_UNREACHABLE ? weights.leafItemStep * item : 0);
+            }
+        }
+    }
+    // Multiplier of the step a bomb with this timer explodes at, were the rollout going on
+    inline int multiplier(char timer) const {
+        return max(0, GLOBAL_GENOME_SIZE + 1 - this->depth - timer);
+    }
+    // Steps to a square out of threat, searched over the open squares without bombs
+    inline int escape(int idx, const BitMask& threat, const BitMask& bombCells) const {
+        const ScoreWeights& weights = this->weights;
+        const BitMask walkable = this->distances.open.andNot(bombCells);
+        BitMask reached = BitMask::cell(idx);
+        for (char e = 1; e <= GLOBAL_LEAF_ESCAPE; ++e) {
+            BitMask next = reached;
+            for (char d = 1; d < 5; ++d) {
+                next |= bitMaskStep(reached, d) & walkable;
+            }
+            reached = next;
+            if (reached.andNot(threat).any()) {
+                return -weights.leafEscapeStep * e;
+            }
+        }
+        return weights.leafTrapped;
+    }
+    template <char P>
+    inline void finish(const Player players [GLOBAL_PLAYER_NUM], int scores [GLOBAL_PLAYER_NUM], const int pending [GLOBAL_PLAYER_NUM],
+                       const BitMask& threat, const BitMask& bombCells) const {
+        for (char k = 0; k < P; ++k) {
+            if (!players[k].isAlive || scores[k] == INT_MIN) {
+                continue;
+            }
+            const int idx = BitMask::index(players[k].p);
+            scores[k] += pending[k] + this->value[k][idx];
+            if (threat.test(idx)) {
+                scores[k] += this->escape(idx, threat, bombCells);
+            }
+        }
+    }
+    // Adds the leaf value to the scores of the surviving players, boxes are credited to the first bomb reaching them
+    template <char P>
+    inline void evaluate(const Board& board, int scores [GLOBAL_PLAYER_NUM]) const {
+        if (this->kind == GLOBAL_LEAF_NONE) {
+            return;
+        }
+        const int box = this->weights.box;
+        int pending [GLOBAL_PLAYER_NUM] = {0};
+        BitMask threat(0, 0, 0);
+        BitMask hit(0, 0, 0);
+        BitMask bombCells(0, 0, 0);
+        const Square* squares = &(board.theBoard[0][0]);
+        for (char i = 0; i < board.bombNum; ++i) {
+            const Bomb& bomb = board.bombs[i];
+            const int origin = bomb.cell;
+            const int reward = box * this->multiplier(bomb.timer);
+            bombCells.set(BitMask::index(bomb.point()));
+            threat.set(BitMask::index(bomb.point()));
+            for (char d = 0; d < 4; ++d) {
+                const char length = min<char>(bomb.range - 1, GLOBAL_BLAST_RAYS.length[origin][d]);
+                for (char k = 0; k < length; ++k) {
+                    const int cell = GLOBAL_BLAST_RAYS.cells[origin][d][k];
+                    const Square& square = squares[cell];
+                    const int idx = BitMask::index(cellPoint(cell));
+                    threat.set(idx);
+                    if (square.blocksExplosion()) {
+                        if (square.isBox() && !hit.test(idx)) {
+                            hit.set(idx);
+                            pending[bomb.owner] += reward;
+                        }
+                        break;
+                    }
+                }
+            }
+        }
+        this->finish<P>(board.players, scores, pending, threat, bombCells);
+    }
+    template <char P>
+    inline void evaluate(const BitBoard& board, int scores [GLOBAL_PLAYER_NUM]) const {
+        if (this->kind == GLOBAL_LEAF_NONE) {
+            return;
+        }
+        const int box = this->weights.box;
+        int pending [GLOBAL_PLAYER_NUM] = {0};
+        BitMask threat = board.bombCells;
+        BitMask hit(0, 0, 0);
+        const BitMask stop = board.blockers();
+        const BitMask boxCells = board.allBoxes();
+        for (char i = 0; i < board.bombNum; ++i) {
+            const BitBomb& bomb = board.bombs[i];
+            const int reward = box * this->multiplier(bomb.timer);
+            for (char d = 1; d <= 4; ++d) {
+                BitMask cur = BitMask::cell(bomb.cell);
+                for (char k = 1; k < bomb.range; ++k) {
+                    cur = bitMaskStep(cur, d);
+                    if (!cur.any()) {
+                        break;
+                    }
+                    threat |= cur;
+                    if ((cur & stop).any()) {
+                        if ((cur & boxCells).andNot(hit).any()) {
+                            hit |= cur;
+                            pending[bomb.owner] += reward;
+                        }
+                        break;
+                    }
+                }
+            }
+        }
+        this->finish<P>(board.players, scores, pending, threat, board.bombCells);
+    }
+};
+
+bool global_use_opponent_model = false;
+const char GLOBAL_OPPONENT_POLICIES = 3;
+const float GLOBAL_OPPONENT_ACCURACY_WEIGHT = 0.2; // of the last observation in the moving accuracy
+const float GLOBAL_OPPONENT_FREEZE_ACCURACY = 0.75;
+const uint GLOBAL_OPPONENT_MIN_OBSERVATIONS = 4;
+
+// Opponents played by a fixed genome instead of being evolved
+struct OpponentPlan {
+    bool frozen [GLOBAL_PLAYER_NUM] = {false};
+    Genome genome [GLOBAL_PLAYER_NUM];
+};
+
+// Cheap policies predicting the opponents, scored against the moves they actually played
+struct OpponentModel {
+    enum policy { still, nearestBox, previousBest };
+    Genome genomes [GLOBAL_PLAYER_NUM][GLOBAL_OPPONENT_POLICIES];
+    float accuracy [GLOBAL_PLAYER_NUM][GLOBAL_OPPONENT_POLICIES];
+    uint observations [GLOBAL_PLAYER_NUM] = {0};
+    bool predicted = false;
+
+    inline OpponentModel() {
+        for (char k = 0; k < GLOBAL_PLAYER_NUM; ++k) {
+            for (char a = 0; a < GLOBAL_OPPONENT_POLICIES; ++a) {
+                this->accuracy[k][a] = 0;
+            }
+        }
+    }
+    inline OpponentModel(OpponentModel const&) = default;
+    inline OpponentModel(OpponentModel&&) = default;
+    inline OpponentModel& operator=(OpponentModel const&) = default;
+    inline OpponentModel& operator=(OpponentModel&&) = default;
+
+    // Walks to the closest square next to a box, drops a bomb there and waits
+    static inline Genome nearestBoxGenome(const Board& board, const Point& start) {
+        Genome res;
+        res.genes = 0;
+        char from [GLOBAL_MAX_WIDTH*GLOBAL_MAX_HEIGHT]; // direction taken to reach each square, -1 unseen
+        fill(from, from + GLOBAL_MAX_WIDTH*GLOBAL_MAX_HEIGHT, -1);
+        myQueue<Point> queue;
+        from[GLOBAL_BLAST_RAYS.index(start)] = 0;
+        queue.push(start);
+        while (!queue.empty()) {
+            const Point cur = queue.front_and_pop();
+            bool nextToBox = false;
+            for (char d = 1; d < 5; ++d) {
+                const Point n(cur.x + GLOBAL_DIRECTION_DX[d], cur.y + GLOBAL_DIRECTION_DY[d]);
+                nextToBox |= n.isInside() && board.theBoard[n.x][n.y].isBox();
+            }
+            if (nextToBox) {
+                char path [GLOBAL_MAX_WIDTH*GLOBAL_MAX_HEIGHT];
+                char length = 0;
+                for (Point p = cur; !(p == start); ) {
+                    const char d = from[GLOBAL_BLAST_RAYS.index(p)];
+                    path[length++] = d;
+                    p = Point(p.x - GLOBAL_DIRECTION_DX[d], p.y - GLOBAL_DIRECTION_DY[d]);
+                }
+                char i = 0;
+                for (; i < length && i < GLOBAL_GENOME_SIZE; ++i) {
+                    res.setGene(i, Gene(path[length - 1 - i], false));
+                }
+                if (i < GLOBAL_GENOME_SIZE) {
+                    res.setGene(i, Gene(0, true));
+                }
+                return res;
+            }
+            for (char d = 1; d < 5; ++d) {
+                const Point n(cur.x + GLOBAL_DIRECTION_DX[d], cur.y + GLOBAL_DIRECTION_DY[d]);
+                if (n.isInside() && from[GLOBAL_BLAST_RAYS.index(n)] == -1 && board.theBoard[n.x][n.y].canEnter()) {
+                    from[GLOBAL_BLAST_RAYS.index(n)] = d;
+                    queue.push(n);
+                }
+            }
+        }
+        return res;
+    }
+    // Compares the first gene predicted on previous with what current shows
+    inline void observe(const Board& previous, const Board& current, const int& myId) {
+        if (!this->predicted) {
+            return;
+        }
+        for (char k = 0; k < GLOBAL_PLAYER_NUM; ++k) {
+            if (k == myId || !previous.players[k].isAlive || !current.players[k].isAlive) {
+                continue;
+            }
+            const Point& from = previous.players[k].p;
+            bool bomb = false;
+            for (char i = 0; i < current.bombNum; ++i) {
+                bomb |= current.bombs[i].owner == k && current.bombs[i].cell == cellIndex(from) && !previous.theBoard[from.x][from.y].containsBomb();
+            }
+            ++this->observations[k];
+            for (char a = 0; a < GLOBAL_OPPONENT_POLICIES; ++a) {
+                const Gene g = this->genomes[k][a].gene(0);
+                const bool hit = previous.getNext(g, from) == current.players[k].p &&
+                                 (g.bomb() && previous.players[k].cur_stock > 0) == bomb;
+                this->accuracy[k][a] += GLOBAL_OPPONENT_ACCURACY_WEIGHT * (hit - this->accuracy[k][a]);
+            }
+        }
+    }
+    inline void predict(const Board& board, const FullGenome& previousBest) {
+        for (char k = 0; k < GLOBAL_PLAYER_NUM; ++k) {
+            this->genomes[k][policy::still].genes = 0;
+            this->genomes[k][policy::nearestBox] = OpponentModel::nearestBoxGenome(board, board.players[k].p);
+            this->genomes[k][policy::previousBest] = previousBest.array[k];
+        }
+        this->predicted = true;
+    }
+    // Opponents whose best policy has been accurate enough lately
+    inline OpponentPlan plan(const int& myId) const {
+        OpponentPlan res;
+        for (char k = 0; k < GLOBAL_PLAYER_NUM; ++k) {
+            if (k == myId || this->observations[k] < GLOBAL_OPPONENT_MIN_OBSERVATIONS) {
+                continue;
+            }
+            char best = 0;
+            for (char a = 1; a < GLOBAL_OPPONENT_POLICIES; ++a) {
+                if (this->accuracy[k][a] > this->accuracy[k][best]) {
+                    best = a;
+                }
+            }
+            if (this->accuracy[k][best] >= GLOBAL_OPPONENT_FREEZE_ACCURACY) {
+                res.frozen[k] = true;
+                res.genome[k] = this->genomes[k][best];
+            }
+        }
+        return res;
+    }
+};
+
+// Fixed set of workers, the calling thread being worker 0. Each worker owns a
+// deque of [begin,end) chunks, takes work from its front and steals from the
+// back of the other deques once its own is empty.
+struct ThreadPool {
+    struct WorkQueue {
+        mutex lock;
+        deque<pair<uint,uint> > chunks;
+    };
+    uint size;
+    vector<thread> threads;
+    vector<WorkQueue> queues;
+    function<void(uint, uint, uint)> job;
+    mutex lock;
+    condition_variable wake;
+    condition_variable done;
+    uint round = 0;
+    uint running = 0;
+    bool stopping = false;
+
+    inline ThreadPool(uint size) : size(size), queues(size) {
+        for (uint w = 1; w < size; ++w) {
+            this->threads.emplace_back([this, w] { this->loop(w); });
+        }
+    }
+    inline ~ThreadPool() {
+        {
+            lock_guard<mutex> guard(this->lock);
+            this->stopping = true;
+        }
+        this->wake.notify_all();
+        for (thread& t : this->threads) {
+            t.join();
+        }
+    }
+    // Calls job(worker, begin, end) on chunks covering [0, n), returns when all are done
+    inline void run(uint n, uint chunk, const function<void(uint, uint, uint)>& job) {
+        {
+            lock_guard<mutex> guard(this->lock);
+            this->job = job;
+            uint w = 0;
+            for (uint begin = 0; begin < n; begin += chunk) {
+                lock_guard<mutex> queueGuard(this->queues[w].lock);
+                this->queues[w].chunks.emplace_back(begin, min(n, begin + chunk));
+                w = (w + 1) % this->size;
+            }
+            this->running = this->size - 1;
+            ++this->round;
+        }
+        this->wake.notify_all();
+        this->work(0);
+        unique_lock<mutex> guard(this->lock);
+        this->done.wait(guard, [this] { return this->running == 0; });
+    }
+    inline bool pop(uint w, pair<uint,uint>& chunk) {
+        for (uint k = 0; k < this->size; ++k) {
+            WorkQueue& queue = this->queues[(w + k) % this->size];
+            lock_guard<mutex> guard(queue.lock);
+            if (queue.chunks.empty()) {
+                continue;
+            }
+            if (k == 0) {
+                chunk = queue.chunks.front();
+                queue.chunks.pop_front();
+            } else {
+                chunk = queue.chunks.back();
+                queue.chunks.pop_back();
+            }
+            return true;
+        }
+        return false;
+    }
+    inline void work(uint w) {
+        pair<uint,uint> chunk;
+        while (this->pop(w, chunk)) {
+            this->job(w, chunk.first, chunk.second);
+        }
+    }
+    inline void loop(uint w) {
+        uint seen = 0;
+        unique_lock<mutex> guard(this->lock);
+        while (true) {
+            this->wake.wait(guard, [&] { return this->stopping || this->round != seen; });
+            if (this->stopping) {
+                return;
+            }
+            seen = this->round;
+            guard.unlock();
+            this->work(w);
+            guard.lock();
+            if (--this->running == 0) {
+                this->done.notify_one();
+            }
+        }
+    }
+};
+
+const uint GLOBAL_POOL_CHUNK = 16;
+uint global_thread_num = 1;
+
+const char GLOBAL_TT_MAX_DEPTH = 4; // rollout steps probed in the transposition table
+
+// Score changes from a state to the end of a rollout, INT_MIN for a death.
+// Shared by the workers of a turn without locks: the check word is the key
+// xor the data, so an entry torn by a concurrent store just misses.
+struct TranspositionTable {
+    struct Entry {
+        atomic<uint64_t> check;
+        atomic<uint64_t> data [GLOBAL_PLAYER_NUM / 2];
+    };
+    vector<Entry> entries;
+    uint64_t mask = 0;
+    // Mixed into every check, so entries of previous turns no longer match
+    uint64_t stamp = 0;
+    uint64_t resets = 0;
+
+    // The table is only reallocated when its size changes, otherwise a new stamp invalidates it
+    inline void reset(uint bits) {
+        if (this->entries.size() != size_t(1) << bits) {
+            vector<Entry>(size_t(1) << bits).swap(this->entries);
+            this->mask = (uint64_t(1) << bits) - 1;
+        }
+        this->stamp = zobrist(GLOBAL_ZOBRIST_STAMP | ++this->resets);
+    }
+    inline bool probe(uint64_t key, int outcome[GLOBAL_PLAYER_NUM]) const {
+        const Entry& entry = this->entries[key & this->mask];
+        uint64_t check = key ^ this->stamp;
+        uint64_t data [GLOBAL_PLAYER_NUM / 2];
+        for (char k = 0; k < GLOBAL_PLAYER_NUM / 2; ++k) {
+            data[k] = entry.data[k].load(memory_order_relaxed);
+            check ^= data[k];
+        }
+        if (entry.check.load(memory_order_relaxed) != check) {
+            return false;
+        }
+        for (char k = 0; k < GLOBAL_PLAYER_NUM / 2; ++k) {
+            outcome[2*k] = int(uint32_t(data[k]));
+            outcome[2*k+1] = int(uint32_t(data[k] >> 32));
+        }
+        return true;
+    }
+    inline void store(uint64_t key, const int outcome[GLOBAL_PLAYER_NUM]) {
+        Entry& entry = this->entries[key & this->mask];
+        uint64_t check = key ^ this->stamp;
+        for (char k = 0; k < GLOBAL_PLAYER_NUM / 2; ++k) {
+            const uint64_t data = uint64_t(uint32_t(outcome[2*k])) | uint64_t(uint32_t(outcome[2*k+1])) << 32;
+            entry.data[k].store(data, memory_order_relaxed);
+            check ^= data;
+        }
+        entry.check.store(check, memory_order_relaxed);
+    }
+};
+static_assert(GLOBAL_PLAYER_NUM % 2 == 0, "transposition entries pack two scores per word");
+
+// Everything a rollout writes to, one per worker thread
+const int GLOBAL_BATCH_LANES = 8;
+
+// The batch functions are built for AVX2 whatever the flags of the build, and only called when
+// the CPU has it. Emulated lanes would be slower than Board::update, so without AVX2 the
+// rollouts are scored one at a time.
+#if defined(__x86_64__) || defined(__i386__)
+#define BOMBERMAN_AVX2 __attribute__((target("avx2")))
+inline bool batchSupported() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+#else
+#define BOMBERMAN_AVX2
+inline bool batchSupported() {
+    return false;
+}
+#endif
+const bool global_batch_supported = batchSupported();
+
+// One 32 bit value per rollout of a batch, 8 lanes fill an AVX2 register. The alignment is
+// explicit, code built without AVX would place them on 16 bytes.
+typedef int32_t BatchInt __attribute__((vector_size(4 * GLOBAL_BATCH_LANES), aligned(4 * GLOBAL_BATCH_LANES)));
+typedef uint32_t BatchWord __attribute__((vector_size(4 * GLOBAL_BATCH_LANES), aligned(4 * GLOBAL_BATCH_LANES)));
+const char GLOBAL_BATCH_WORDS = 6; // a BitMask in 32 bit words
+
+// One BitMask per lane, a lane mask is all ones where a condition holds
+struct BatchMask {
+    BatchWord w[GLOBAL_BATCH_WORDS];
+
+    inline BOMBERMAN_AVX2 void broadcast(const BitMask& m) {
+        for (char k = 0; k < GLOBAL_BATCH_WORDS; ++k) {
+            this->w[k] = BatchWord{} + uint32_t(m.w[k / 2] >> (32 * (k & 1)));
+        }
+    }
+    inline BOMBERMAN_AVX2 BitMask lane(int l) const {
+        return BitMask(this->w[0][l] | uint64_t(this->w[1][l]) << 32, this->w[2][l] | uint64_t(this->w[3][l]) << 32,
+                       this->w[4][l] | uint64_t(this->w[5][l]) << 32);
+    }
+    inline BOMBERMAN_AVX2 void setLane(int l, const BitMask& m) {
+        for (char k = 0; k < GLOBAL_BATCH_WORDS; ++k) {
+            this->w[k][l] = m.w[k / 2] >> (32 * (k & 1));
+        }
+    }
+    inline BOMBERMAN_AVX2 BatchMask operator|(const BatchMask& m) const {
+        BatchMask res;
+        for (char k = 0; k < GLOBAL_BATCH_WORDS; ++k) {
+            res.w[k] = this->w[k] | m.w[k];
+        }
+        return res;
+    }
+    inline BOMBERMAN_AVX2 BatchMask andNot(const BatchMask& m) const {
+        BatchMask res;
+        for (char k = 0; k < GLOBAL_BATCH_WORDS; ++k) {
+            res.w[k] = this->w[k] & ~m.w[k];
+        }
+        return res;
+    }
+    // All ones in the lanes where cell idx is set
+    inline BOMBERMAN_AVX2 BatchInt test(const BatchInt& idx) const {
+        const BatchInt word = idx >> 5;
+        BatchWord w = BatchWord{};
+        for (char k = 0; k < GLOBAL_BATCH_WORDS; ++k) {
+            w |= this->w[k] & (BatchWord) (word == k);
+        }
+        return -(BatchInt) ((w >> (BatchWord) (idx & 31)) & 1);
+    }
+    inline BOMBERMAN_AVX2 void set(const BatchInt& idx, const BatchInt& on) {
+        const BatchInt word = idx >> 5;
+        const BatchWord bit = (BatchWord{} + 1) << (BatchWord) (idx & 31);
+        for (char k = 0; k < GLOBAL_BATCH_WORDS; ++k) {
+            this->w[k] |= bit & (BatchWord) (on & (word == k));
+        }
+    }
+    inline BOMBERMAN_AVX2 void reset(const BatchInt& idx, const BatchInt& on) {
+        const BatchInt word = idx >> 5;
+        const BatchWord bit = (BatchWord{} + 1) << (BatchWord) (idx & 31);
+        for (char k = 0; k < GLOBAL_BATCH_WORDS; ++k) {
+            this->w[k] &= ~(bit & (BatchWord) (on & (word == k)));
+        }
+    }
+};
+
+inline BOMBERMAN_AVX2 BatchInt batchSelect(const BatchInt& on, const BatchInt& a, const BatchInt& b) {
+    return (a & on) | (b & ~on);
+}
+
+// GLOBAL_BATCH_LANES rollouts from the same root advanced in lockstep, same rules as BitBoard::update.
+// Timers, moves, bomb drops, items and scores are computed for all lanes at once, a lane
+// where bombs explode goes through BitBoard::explode.
+struct BatchSim {
+    BatchMask walls;
+    BatchMask boxes;
+    BatchMask boxesRange;
+    BatchMask boxesStock;
+    BatchMask itemsRange;
+    BatchMask itemsStock;
+    BatchMask bombCells;
+    BatchWord genes [GLOBAL_PLAYER_NUM][2]; // genes 0-7 and 8-15
+    BatchInt cell [GLOBAL_PLAYER_NUM];
+    BatchInt column [GLOBAL_PLAYER_NUM];
+    BatchInt range [GLOBAL_PLAYER_NUM];
+    BatchInt stock [GLOBAL_PLAYER_NUM];
+    BatchInt reloading [GLOBAL_PLAYER_NUM];
+    BatchInt boxScore [GLOBAL_PLAYER_NUM]; // Player::score
+    BatchInt alive [GLOBAL_PLAYER_NUM];
+    BatchInt scores [GLOBAL_PLAYER_NUM];
+    BatchInt result [GLOBAL_PLAYER_NUM]; // scores when the lane finished
+    BatchInt done; // our player is dead, or the lane is not used
+    BatchInt bombNum;
+    BatchInt bombTimer [GLOBAL_MAX_BOMBS];
+    unsigned char bombOwner [GLOBAL_MAX_BOMBS][GLOBAL_BATCH_LANES];
+    unsigned char bombRange [GLOBAL_MAX_BOMBS][GLOBAL_BATCH_LANES];
+    unsigned char bombCell [GLOBAL_MAX_BOMBS][GLOBAL_BATCH_LANES];
+    char maxBombNum = 0; // over the lanes
+    uint steps = 0; // lane steps simulated for unfinished lanes
+    BitBoard lane; // a lane being exploded
+
+    inline BatchSim() = default;
+    inline BatchSim(BatchSim const&) = default;
+    inline BatchSim(BatchSim&&) = default;
+    inline BatchSim& operator=(BatchSim const&) = default;
+    inline BatchSim& operator=(BatchSim&&) = default;
+
+    // Lane l < n plays genes[k][begin + l] for each player k
+    template <char P>
+    inline BOMBERMAN_AVX2 void load(const BitBoard& root, const uint64_t genes [][GLOBAL_POPULATION_SIZE], uint begin, int n) {
+        this->walls.broadcast(root.walls);
+        this->boxes.broadcast(root.boxes);
+        this->boxesRange.broadcast(root.boxesRange);
+        this->boxesStock.broadcast(root.boxesStock);
+        this->itemsRange.broadcast(root.itemsRange);
+        this->itemsStock.broadcast(root.itemsStock);
+        this->bombCells.broadcast(root.bombCells);
+        for (char k = 0; k < P; ++k) {
+            const Player& player = root.players[k];
+            for (int l = 0; l < GLOBAL_BATCH_LANES; ++l) {
+                const uint64_t lane = l < n ? genes[k][begin + l] : 0;
+                this->genes[k][0][l] = lane;
+                this->genes[k][1][l] = lane >> 32;
+            }
+            this->cell[k] = BatchInt{} + BitMask::index(player.p);
+            this->column[k] = BatchInt{} + player.p.x;
+            this->range[k] = BatchInt{} + player.range;
+            this->stock[k] = BatchInt{} + player.cur_stock;
+            this->reloading[k] = BatchInt{} + player.reloading_stock;
+            this->boxScore[k] = BatchInt{} + player.score;
+            this->alive[k] = BatchInt{} - (int32_t) player.isAlive;
+            this->scores[k] = this->result[k] = BatchInt{} + root.scores[k];
+        }
+        for (int l = 0; l < GLOBAL_BATCH_LANES; ++l) {
+            this->done[l] = l < n ? 0 : -1;
+        }
+        this->bombNum = BatchInt{} + root.bombNum;
+        this->maxBombNum = root.bombNum;
+        for (char b = 0; b < root.bombNum; ++b) {
+            this->bombTimer[b] = BatchInt{} + root.bombs[b].timer;
+            memset(this->bombOwner[b], root.bombs[b].owner, GLOBAL_BATCH_LANES);
+            memset(this->bombRange[b], root.bombs[b].range, GLOBAL_BATCH_LANES);
+            memset(this->bombCell[b], root.bombs[b].cell, GLOBAL_BATCH_LANES);
+        }
+        this->lane = root;
+    }
+    // Copies lane l into this->lane
+    template <char P>
+    inline BOMBERMAN_AVX2 void gatherLane(int l) {
+        BitBoard& board = this->lane;
+        board.boxes = this->boxes.lane(l);
+        board.boxesRange = this->boxesRange.lane(l);
+        board.boxesStock = this->boxesStock.lane(l);
+        board.itemsRange = this->itemsRange.lane(l);
+        board.itemsStock = this->itemsStock.lane(l);
+        board.bombCells = this->bombCells.lane(l);
+        for (char k = 0; k < P; ++k) {
+            Player& player = board.players[k];
+            player.p = BitMask::point(this->cell[k][l]);
+            player.score = this->boxScore[k][l];
+            player.reloading_stock = this->reloading[k][l];
+            player.isAlive = this->alive[k][l] != 0;
+        }
+        board.bombNum = this->bombNum[l];
+        for (char b = 0; b < board.bombNum; ++b) {
+            BitBomb& bomb = board.bombs[b];
+            bomb.owner = this->bombOwner[b][l];
+            bomb.range = this->bombRange[b][l];
+            bomb.timer = this->bombTimer[b][l];
+            bomb.cell = this->bombCell[b][l];
+        }
+    }
+    template <char P>
+    inline BOMBERMAN_AVX2 void explodeLane(int l, BatchMask& deleteBox) {
+        this->gatherLane<P>(l);
+        BitBoard& board = this->lane;
+        BitMask deleted;
+        board.explode(deleted);
+        deleteBox.setLane(l, deleted);
+        this->itemsRange.setLane(l, board.itemsRange);
+        this->itemsStock.setLane(l, board.itemsStock);
+        this->bombCells.setLane(l, board.bombCells);
+        for (char k = 0; k < P; ++k) {
+            this->boxScore[k][l] = board.players[k].score;
+            this->reloading[k][l] = board.players[k].reloading_stock;
+            this->alive[k][l] = -(int32_t) board.players[k].isAlive;
+        }
+        this->bombNum[l] = board.bombNum;
+        for (char b = 0; b < board.bombNum; ++b) {
+            const BitBomb& bomb = board.bombs[b];
+            this->bombOwner[b][l] = bomb.owner;
+            this->bombRange[b][l] = bomb.range;
+            this->bombTimer[b][l] = bomb.timer;
+            this->bombCell[b][l] = bomb.cell;
+        }
+    }
+    // Step i of the genomes, lanes where player id dies finish with the scores of that step
+    template <char P>
+    inline BOMBERMAN_AVX2 void step(const int& id, char i, int multiplier, const ScoreWeights& weights) {
+        BatchInt explodes = BatchInt{};
+        for (char b = 0; b < this->maxBombNum; ++b) {
+            const BatchInt active = b < this->bombNum;
+            this->bombTimer[b] -= active & 1;
+            explodes |= active & (this->bombTimer[b] <= 0);
+        }
+        explodes &= ~this->done;
+        BatchInt temp [GLOBAL_PLAYER_NUM];
+        for (char k = 0; k < P; ++k) {
+            temp[k] = this->boxScore[k];
+        }
+        BatchMask deleteBox;
+        deleteBox.broadcast(BitMask(0, 0, 0));
+        for (int l = 0; l < GLOBAL_BATCH_LANES; ++l) {
+            if (explodes[l]) {
+                this->explodeLane<P>(l, deleteBox);
+            }
+        }
+        // Moves are decided on the board after the explosions, before any new bomb
+        const BatchMask solid = this->walls | this->boxes | this->boxesRange | this->boxesStock;
+        BatchInt action [GLOBAL_PLAYER_NUM];
+        BatchInt next [GLOBAL_PLAYER_NUM];
+        BatchInt nextColumn [GLOBAL_PLAYER_NUM];
+        for (char k = 0; k < P; ++k) {
+            action[k] = (BatchInt) ((this->genes[k][i >= 8] >> (4 * (i & 7))) & 0xF);
+            const BatchInt direction = action[k] & 7;
+            const BatchInt right = (direction == 1) & (this->column[k] < GLOBAL_MAX_WIDTH - 1);
+            const BatchInt down = (direction == 2) & (this->cell[k] + GLOBAL_MAX_WIDTH < GLOBAL_CELL_NUM);
+            const BatchInt left = (direction == 3) & (this->column[k] > 0);
+            const BatchInt up = (direction == 4) & (this->cell[k] >= GLOBAL_MAX_WIDTH);
+            const BatchInt target = this->cell[k] + (right & 1) - (left & 1) + (down & GLOBAL_MAX_WIDTH) - (up & GLOBAL_MAX_WIDTH);
+            const BatchInt free = (right | down | left | up) & ~(solid.test(target) | this->bombCells.test(target));
+            next[k] = batchSelect(free, target, this->cell[k]);
+            nextColumn[k] = this->column[k] + (free & ((right & 1) - (left & 1)));
+        }
+        for (char k = 0; k < P; ++k) {
+            const BatchInt alive = this->alive[k];
+            const BatchInt idx = this->cell[k];
+            BatchInt& score = this->scores[k];
+            score = batchSelect(alive, score, BatchInt{} + INT_MIN);
+            const BatchInt drop = alive & ~this->done & ((action[k] & 8) != 0) & (this->stock[k] > 0) & ~this->bombCells.test(idx) & (this->bombNum < GLOBAL_MAX_BOMBS);
+            for (int l = 0; l < GLOBAL_BATCH_LANES; ++l) {
+                if (drop[l]) {
+                    const char b = this->bombNum[l]++;
+                    this->bombOwner[b][l] = k;
+                    this->bombRange[b][l] = this->range[k][l];
+                    this->bombTimer[b][l] = 8;
+                    this->bombCell[b][l] = idx[l];
+                    this->maxBombNum = max<char>(this->maxBombNum, b + 1);
+                }
+            }
+            this->stock[k] -= drop & 1;
+            this->bombCells.set(idx, drop);
+            score += drop & weights.bomb;
+            score += alive & ((this->boxScore[k] - temp[k]) * (multiplier * weights.box));
+            const BatchInt stay = alive & (next[k] == idx);
+            score += stay & weights.stay;
+            const BatchInt enter = alive & ~stay & ~(solid.test(next[k]) | this->bombCells.test(next[k]));
+            const BatchInt rangeItem = enter & this->itemsRange.test(next[k]);
+            const BatchInt stockItem = enter & ~rangeItem & this->itemsStock.test(next[k]);
+            this->range[k] += rangeItem & 1;
+            score += rangeItem & (weights.rangeItem * multiplier);
+            this->itemsRange.reset(next[k], rangeItem);
+            score += stockItem & (this->stock[k] < weights.stockCap) & (weights.stockItem * multiplier);
+            this->stock[k] += stockItem & 1;
+            this->itemsStock.reset(next[k], stockItem);
+            this->cell[k] = batchSelect(enter, next[k], idx);
+            this->column[k] = batchSelect(enter, nextColumn[k], this->column[k]);
+            this->stock[k] += alive & this->reloading[k];
+            this->reloading[k] &= ~alive;
+        }
+        this->boxes = this->boxes.andNot(deleteBox);
+        this->boxesRange = this->boxesRange.andNot(deleteBox);
+        this->boxesStock = this->boxesStock.andNot(deleteBox);
+        for (char k = 0; k < P; ++k) {
+            this->result[k] = batchSelect(this->done, this->result[k], this->scores[k]);
+        }
+        for (int l = 0; l < GLOBAL_BATCH_LANES; ++l) {
+            this->steps += !this->done[l];
+        }
+        this->done |= this->scores[id] == INT_MIN;
+    }
+    // Plays the first depth genes, result holds the scores of every lane
+    template <char P>
+    inline BOMBERMAN_AVX2 void run(const int& id, char depth, const ScoreWeights& weights) {
+        for (char i = 0; i < depth; ++i) {
+            this->step<P>(id, i, GLOBAL_GENOME_SIZE - i, weights);
+            bool finished = true;
+            for (int l = 0; l < GLOBAL_BATCH_LANES; ++l) {
+                finished &= this->done[l] != 0;
+            }
+            if (finished) {
+                break;
+            }
+        }
+    }
+};
+
+struct RolloutWorker {
+    Board board;
+    BitBoard bitBoard;
+    BatchSim batch;
+    SimScratch scratch;
+    UndoLog journal;
+    const Board* base = NULL; // board is a copy of *base between undo rollouts
+    uint ttProbes = 0;
+    uint ttHits = 0;
+    uint ttStores = 0;
+    uint steps = 0; // Board::update calls
+    uint skippedSteps = 0; // steps taken from a parent checkpoint instead
+};
+
+bool global_use_population_store = false;
+
+// The genomes of a generation, one cache aligned array of genes and one of scores per player
+struct Population {
+    alignas(64) uint64_t genes [GLOBAL_PLAYER_NUM][GLOBAL_POPULATION_SIZE];
+    alignas(64) int scores [GLOBAL_PLAYER_NUM][GLOBAL_POPULATION_SIZE];
+
+    inline FullGenome get(uint i) const {
+        FullGenome res;
+        for (char k = 0; k < GLOBAL_PLAYER_NUM; ++k) {
+            res.array[k].genes = this->genes[k][i];
+            res.array[k].score = this->scores[k][i];
+        }
+        return res;
+    }
+    inline void set(uint i, const FullGenome& g) {
+        for (char k = 0; k < GLOBAL_PLAYER_NUM; ++k) {
+            this->genes[k][i] = g.array[k].genes;
+            this->scores[k][i] = g.array[k].score;
+        }
+    }
+    template <char P>
+    inline void setScores(uint i, const FullGenome& g) {
+        for (char k = 0; k < P; ++k) {
+            this->scores[k][i] = g.array[k].score;
+        }
+    }
+};
+
+// Boards of a rollout after each of its steps
+struct RolloutCheckpoints {
+    Board boards [GLOBAL_GENOME_SIZE];
+    char steps = 0;
+    bool complete = false; // ended by a death or the last gene, not by a transposition hit
+};
+
+// Kept by the bot across turns and reset at the start of each, so that its buffers
+// are allocated once and its elites can seed the next turn
+struct Evolution {
+    Population population;
+    bool evaluated [GLOBAL_POPULATION_SIZE];
+    EliteGenomes theTopGenomes [GLOBAL_PLAYER_NUM];
+    const Board* root = NULL;
+    BitBoard rootBitBoard;
+    Timer* timer = NULL;
+    ThreadPool* pool = NULL;
+    Rng* rng = NULL;
+    vector<RolloutWorker> workers;
+    TranspositionTable tt;
+    uint64_t rootHash = 0;
+    vector<RolloutCheckpoints> checkpoints;
+    char parents [GLOBAL_POPULATION_SIZE][2];
+    vector<DangerMap> danger;
+    bool escapable [GLOBAL_PLAYER_NUM];
+    OpponentPlan opponents;
+    SearchConfig config;
+    LeafEvaluator leaf;
+    uint doomed = 0; // random genomes walking into an avoidable blast
+    uint redrawn = 0; // of which were replaced by a safe one
+    uint compute = 0;
+    uint generation = 0;
+    uint maxGeneration = 0; // 0: until the timer runs out
+#ifdef BOMBERMAN_TELEMETRY
+    vector<int> bestScores; // our best score after each generation
+#endif
+    
+    inline Evolution() = default;
+    inline Evolution(Evolution const&) = default;
+    inline Evolution(Evolution&&) = default;
+    inline Evolution& operator=(Evolution const&) = default;
+    inline Evolution& operator=(Evolution&&) = default;
+
+    inline Evolution(const int& id, uint max, const FullGenome& bestFullGenomes, const Board& root, Timer& timer, Rng& rng, ThreadPool* pool = NULL,
+                     const OpponentPlan& opponents = OpponentPlan(), const SearchConfig& config = global_config) {
+        this->reset(id, max, bestFullGenomes, root, timer, rng, pool, opponents, config);
+    }
+
+    // Scores bestFullGenomes and max - 1 random genomes on a new root. A warm start scores instead
+    // a first generation bred from the elites of the previous turn, shifted by one step as in Genome::nextGen.
+    inline void reset(const int& id, uint max, const FullGenome& bestFullGenomes, const Board& root, Timer& timer, Rng& rng, ThreadPool* pool = NULL,
+                      const OpponentPlan& opponents = OpponentPlan(), const SearchConfig& config = global_config, bool warm = false) {
+        warm &= this->theTopGenomes[id].size > 0;
+        // The elites are the first genomes of each generation, the children need room after them
+        const uint eliteSize = min(config.eliteSize, config.populationSize - 1);
+        Genome elites [GLOBAL_PLAYER_NUM][GLOBAL_MAX_ELITE_SIZE];
+        if (warm) {
+            for (char k = 0; k < root.playerNum; ++k) {
+                this->theTopGenomes[k].sorted(elites[k]);
+                for (uint i = 0; i < eliteSize; ++i) {
+                    elites[k][i].nextGen(rng);
+                }
+            }
+        }
+        this->root = &root;
+        this->timer = &timer;
+        this->pool = pool;
+        this->rng = &rng;
+        this->opponents = opponents;
+        this->config = config;
+        this->config.eliteSize = eliteSize;
+        this->workers.resize(pool ? pool->size : 1);
+        for (RolloutWorker& worker : this->workers) {
+            worker.scratch.weights = config.weights;
+            worker.base = NULL;
+            worker.ttProbes = worker.ttHits = worker.ttStores = 0;
+            worker.steps = worker.skippedSteps = 0;
+        }
+        for (char k = 0; k < GLOBAL_PLAYER_NUM; ++k) {
+            this->theTopGenomes[k] = EliteGenomes(this->config.eliteSize);
+        }
+        this->doomed = this->redrawn = 0;
+        this->compute = this->generation = 0;
+        this->maxGeneration = config.maxGenerations;
+#ifdef BOMBERMAN_TELEMETRY
+        this->bestScores.clear();
+#endif
+        this->leaf.build(root, config);
+        if (config.bitboard || config.batch) {
+            this->rootBitBoard.load(root);
+        }
+        if (config.ttBits) {
+            this->tt.reset(config.ttBits);
+            this->rootHash = root.computeHash();
         }
+        this->danger.clear();
+        if (config.dangerMap) {
+            this->danger.resize(1);
+            this->danger[0].build(root);
+            for (char k = 0; k < GLOBAL_PLAYER_NUM; ++k) {
+                this->escapable[k] = root.players[k].isAlive && this->danger[0].canEscape(root.players[k].p);
+            }
+        }
+        this->checkpoints.clear();
+        if (config.checkpoints && !config.bitboard) {
+            this->checkpoints.resize(this->config.eliteSize);
+        }
+        for (uint i = 0; i < GLOBAL_POPULATION_SIZE; ++i) {
+            this->parents[i][0] = this->parents[i][1] = -1;
+        }
+        FullGenome first = bestFullGenomes;
+        this->applyOpponents(first);
+        forPlayerNum(root.playerNum, [&](auto players) {
+            constexpr char P = decltype(players)::value;
+            this->calculateScoreAndReplace<P>(id,first);
+            if (warm) {
+                this->breed<P>(id, elites);
+                return;
+            }
+            for (uint done = 1; done < max && !(this->timer->isTimesUp()); done += config.populationSize) {
+                uint n = min(config.populationSize, max - done);
+                for (uint i = 0; i < n; ++i) {
+                    this->population.set(i, this->randomFullGenome<P>());
+                }
+                this->scorePopulation<P>(id, 0, n);
+            }
+        });
     }
-    inline void cross(const FullGenome& g1, const FullGenome& g2){
-        for(g_FullGenome_i=0;g_FullGenome_i<GLOBAL_PLAYER_NUM;++g_FullGenome_i){
-            this->array[g_FullGenome_i].cross(g1.array[g_FullGenome_i],g2.array[g_FullGenome_i]);
+    inline void applyOpponents(FullGenome& g) const {
+        for (char k = 0; k < GLOBAL_PLAYER_NUM; ++k) {
+            if (this->opponents.frozen[k]) {
+                g.array[k].genes = this->opponents.genome[k].genes;
+            }
         }
     }
-    inline void mutate(const FullGenome& g1){
-        for(g_FullGenome_i=0;g_FullGenome_i<GLOBAL_PLAYER_NUM;++g_FullGenome_i){
-            this->array[g_FullGenome_i].mutate(g1.array[g_FullGenome_i]);
+    // Players whose genome runs into a blast they can avoid get a few fresh draws
+    template <char P = GLOBAL_PLAYER_NUM>
+    inline FullGenome randomFullGenome() {
+        FullGenome res;
+        res.randomize<P>(*this->rng);
+        this->applyOpponents(res);
+        if (this->danger.empty()) {
+            return res;
+        }
+        for (char k = 0; k < P; ++k) {
+            const Player& player = this->root->players[k];
+            if (!this->escapable[k] || this->opponents.frozen[k] || this->danger[0].doomedAt(res.array[k], player.p) == GLOBAL_GENOME_SIZE) {
+                continue;
+            }
+            ++this->doomed;
+            for (char tries = 0; tries < GLOBAL_DANGER_REDRAWS; ++tries) {
+                res.array[k].randomize(*this->rng);
+                if (this->danger[0].doomedAt(res.array[k], player.p) == GLOBAL_GENOME_SIZE) {
+                    ++this->redrawn;
+                    break;
+                }
+            }
+        }
+        return res;
+    }
+    template <char P>
+    inline void calculateScoreBitBoard(const int& id, FullGenome & genomes, RolloutWorker& worker)
+    {
+        char i;
+        worker.bitBoard = this->rootBitBoard;
+        for (i=0; i<this->config.depth; ++i) {
+            Gene gArray[GLOBAL_PLAYER_NUM];
+            genomes.genes<P>(i, gArray);
+            worker.bitBoard.updateFor<P>(gArray, GLOBAL_GENOME_SIZE-i, this->config.weights);
+            if(worker.bitBoard.scores[id] == INT_MIN) {
+                break;
+            }
+        }
+        if (i == this->config.depth) {
+            this->leaf.evaluate<P>(worker.bitBoard, worker.bitBoard.scores);
+        }
+        for (i=0; i<P; ++i) {
+            genomes.array[i].score = worker.bitBoard.scores[i];
+        }
+    }
+
+    // Scores population[begin, begin + n) in lockstep, n <= GLOBAL_BATCH_LANES
+    template <char P>
+    inline void calculateScoreBatch(const int& id, uint begin, int n, RolloutWorker& worker) {
+        BatchSim& batch = worker.batch;
+        batch.steps = 0;
+        batch.load<P>(this->rootBitBoard, this->population.genes, begin, n);
+        batch.run<P>(id, this->config.depth, this->config.weights);
+        worker.steps += batch.steps;
+        for (int l = 0; l < n; ++l) {
+            int scores [GLOBAL_PLAYER_NUM];
+            for (char k = 0; k < P; ++k) {
+                scores[k] = batch.result[k][l];
+            }
+            if (this->leaf.kind != GLOBAL_LEAF_NONE && !batch.done[l]) {
+                batch.gatherLane<P>(l);
+                this->leaf.evaluate<P>(batch.lane, scores);
+            }
+            for (char k = 0; k < P; ++k) {
+                this->population.scores[k][begin + l] = scores[k];
+            }
         }
     }
-};
-
-struct Evolution {
-    FullGenome theFullGenomes [GLOBAL_POPULATION_SIZE];
-    Top10Genome theTopGenomes [GLOBAL_PLAYER_NUM];
-    FullGenome bestFullGenome;
-    
-    inline Evolution() = default;
-    inline Evolution(Evolution const&) = default;
-    inline Evolution(Evolution&&) = default;
-    inline Evolution& operator=(Evolution const&) = default;
-    inline Evolution& operator=(Evolution&&) = default;
 
-    inline Evolution(const int& id, uint max, const FullGenome& bestFullGenomes) {
-        calculateScoreAndReplace(id,bestFullGenomes);
-        for (uint i=1; i<max && !(global_timer->isTimesUp()); ++i) {
-            calculateScoreAndReplace(id, FullGenome());
-        }        
-    }    
-    
-    inline void calculateScore(const int& id, FullGenome & genomes, const Board & board)
+    // board is the state after the first `from` steps of genomes, record gets the board after every step
+    template <char P>
+    inline void calculateScore(const int& id, FullGenome & genomes, const Board & board, RolloutWorker& worker,
+                               char from = 0, RolloutCheckpoints* record = NULL)
     {
+        if (this->config.bitboard && &board == this->root) {
+            this->calculateScoreBitBoard<P>(id, genomes, worker);
+            return;
+        }
         char i;    
-        global_working_board = board;
-        for (i=0; i<GLOBAL_GENOME_SIZE; ++i) {                
+        const bool undo = this->config.undo && from == 0;
+        const bool useTT = this->config.ttBits && (&board == this->root || from > 0);
+        uint64_t keys [GLOBAL_TT_MAX_DEPTH];
+        int keyScores [GLOBAL_TT_MAX_DEPTH][GLOBAL_PLAYER_NUM];
+        char probed = from;
+        if (!undo) {
+            worker.board = board;
+            worker.board.journal = NULL;
+            worker.base = NULL;
+        } else if (worker.base != &board) {
+            worker.board = board;
+            worker.board.journal = &worker.journal;
+            worker.base = &board;
+        }
+        worker.board.hashed = useTT;
+        if (useTT && from == 0) {
+            worker.board.hash = this->rootHash;
+        }
+        if (record != NULL) {
+            record->steps = 0;
+            record->complete = false;
+        }
+        for (i=from; i<this->config.depth; ++i) {
+            if (useTT && i < GLOBAL_TT_MAX_DEPTH) {
+                int outcome [GLOBAL_PLAYER_NUM];
+                keys[i] = this->ttKey(id, genomes, worker.board, i);
+                ++worker.ttProbes;
+                if (this->tt.probe(keys[i], outcome)) {
+                    ++worker.ttHits;
+                    for (char k = 0; k < P; ++k) {
+                        worker.board.scores[k] = outcome[k] == INT_MIN ? INT_MIN : worker.board.scores[k] + outcome[k];
+                    }
+                    break;
+                }
+                for (char k = 0; k < P; ++k) {
+                    keyScores[i][k] = worker.board.scores[k];
+                }
+                probed = i + 1;
+            }
             Gene gArray[GLOBAL_PLAYER_NUM];        
-            genomes.genes(i, gArray);        
-            global_working_board.update(gArray, GLOBAL_GENOME_SIZE-i);           
-            if(global_working_board.scores[id] == INT_MIN) {
+            genomes.genes<P>(i, gArray);        
+            worker.board.updateFor<P>(gArray, GLOBAL_GENOME_SIZE-i, worker.scratch);           
+            ++worker.steps;
+            if (record != NULL) {
+                record->boards[i] = worker.board;
+                record->steps = i + 1;
+            }
+#ifdef BOMBERMAN_CHECK_HASH
+            if (useTT && worker.board.hash != worker.board.computeHash()) {
+                cerr << "calculateScore: incremental hash differs from a full recompute at step " << to_string(worker.board.step) << endl;
+                abort();
+            }
+#endif
+            if(worker.board.scores[id] == INT_MIN) {
+                if (record != NULL) {
+                    record->complete = true;
+                }
                 break;
             }                
         }            
-        for (i=0; i<GLOBAL_PLAYER_NUM; ++i) {
-            genomes.array[i].score = global_working_board.scores[i];
+        if (i == this->config.depth) {
+            this->leaf.evaluate<P>(worker.board, worker.board.scores);
+            if (record != NULL) {
+                record->complete = true;
+            }
+        }
+        for (i=0; i<P; ++i) {
+            genomes.array[i].score = worker.board.scores[i];
         }    
+        for (char d = from; d < probed; ++d) {
+            int outcome [GLOBAL_PLAYER_NUM] = {};
+            for (char k = 0; k < P; ++k) {
+                outcome[k] = worker.board.scores[k] == INT_MIN ? INT_MIN : worker.board.scores[k] - keyScores[d][k];
+            }
+            this->tt.store(keys[d], outcome);
+            ++worker.ttStores;
+        }
+        if (undo) {
+            worker.board.rewind(board);
+        }
+    }
+    // Number of leading steps where every player plays the same genes in population[a] and population[b]
+    template <char P>
+    inline char sharedPrefix(uint a, uint b) const {
+        char res = GLOBAL_GENOME_SIZE;
+        for (char i = 0; i < P; ++i) {
+            const uint64_t diff = this->population.genes[i][a] ^ this->population.genes[i][b];
+            if (diff != 0) {
+                res = min<char>(res, __builtin_ctzll(diff) / 4);
+            }
+        }
+        return res;
+    }
+    // Scores population[i], parents record their checkpoints and children resume from them
+    template <char P>
+    inline void evaluate(const int& id, uint i, RolloutWorker& worker) {
+        FullGenome genomes = this->population.get(i);
+        if (this->checkpoints.empty()) {
+            this->calculateScore<P>(id, genomes, *this->root, worker);
+            this->population.setScores<P>(i, genomes);
+            return;
+        }
+        if (i < this->config.eliteSize) {
+            this->calculateScore<P>(id, genomes, *this->root, worker, 0, &this->checkpoints[i]);
+            this->population.setScores<P>(i, genomes);
+            return;
+        }
+        char best = -1;
+        char bestSteps = 0;
+        for (char k = 0; k < 2; ++k) {
+            const char parent = this->parents[i][k];
+            if (parent == -1) {
+                continue;
+            }
+            const RolloutCheckpoints& checkpoint = this->checkpoints[parent];
+            const char steps = min(this->sharedPrefix<P>(i, parent), checkpoint.steps);
+            if (steps > bestSteps || (steps == bestSteps && steps == checkpoint.steps && checkpoint.complete)) {
+                best = parent;
+                bestSteps = steps;
+            }
+        }
+        if (best == -1 || bestSteps == 0) {
+            this->calculateScore<P>(id, genomes, *this->root, worker);
+            this->population.setScores<P>(i, genomes);
+            return;
+        }
+        const RolloutCheckpoints& checkpoint = this->checkpoints[best];
+        worker.skippedSteps += bestSteps;
+        if (bestSteps == checkpoint.steps && checkpoint.complete) {
+            // Same moves up to the parent's death or last gene: same scores
+            for (char k = 0; k < P; ++k) {
+                this->population.scores[k][i] = this->population.scores[k][best];
+            }
+            return;
+        }
+        this->calculateScore<P>(id, genomes, checkpoint.boards[bestSteps - 1], worker, bestSteps);
+        this->population.setScores<P>(i, genomes);
+    }
+    inline void depthStats(uint& steps, uint& skippedSteps) const {
+        steps = skippedSteps = 0;
+        for (const RolloutWorker& worker : this->workers) {
+            steps += worker.steps;
+            skippedSteps += worker.skippedSteps;
+        }
+    }
+    // The rest of a rollout only depends on the state, our id, the depth and the genes left:
+    // player scores are not part of it since only their changes are stored
+    inline uint64_t ttKey(const int& id, const FullGenome& genomes, const Board& board, char depth) const {
+        uint64_t key = board.hash ^ zobrist(GLOBAL_ZOBRIST_DEPTH | id << 8 | depth);
+        for (char i = 0; i < GLOBAL_PLAYER_NUM; ++i) {
+            const Player& player = board.players[i];
+            if (player.isAlive) {
+                const uint64_t feature = GLOBAL_ZOBRIST_PLAYER | uint64_t(i) << 40 | uint64_t(GLOBAL_BLAST_RAYS.index(player.p)) << 24
+                                         | uint64_t((unsigned char)player.range) << 16 | uint64_t((unsigned char)player.cur_stock) << 8;
+                key ^= zobrist(zobrist(genomes.array[i].genes >> (4*depth)) ^ feature);
+            }
+        }
+        return key;
+    }
+    inline void ttStats(uint& probes, uint& hits, uint& stores) const {
+        probes = hits = stores = 0;
+        for (const RolloutWorker& worker : this->workers) {
+            probes += worker.ttProbes;
+            hits += worker.ttHits;
+            stores += worker.ttStores;
+        }
+    }
+    inline void calculateScore(const int& id, FullGenome & genomes, const Board & board)
+    {
+        forPlayerNum(board.playerNum, [&](auto players) {
+            this->calculateScore<decltype(players)::value>(id, genomes, board, this->workers[0]);
+        });
     }
     
-    inline void calculateScoreAndReplace(const int& id, FullGenome g) {// Not sure about putting a ref here or not
-        calculateScore(id, g, *global_board);
-        for(char i = 0;i<GLOBAL_PLAYER_NUM;++i){            
+    template <char P>
+    inline void replace(const FullGenome& g) {
+        for(char i = 0;i<P;++i){            
             this->theTopGenomes[i].addSup(g.array[i]);                            
         }
-        ++global_compute;
+        ++this->compute;
+    }
+    template <char P>
+    inline void calculateScoreAndReplace(const int& id, FullGenome g) {// Not sure about putting a ref here or not
+        calculateScore<P>(id, g, *this->root, this->workers[0]);
+        this->replace<P>(g);
+    }
+    // Scores population[begin, end) on the pool until the timer runs out
+    template <char P>
+    inline void scorePopulation(const int& id, uint begin, uint end) {
+        for (uint i = begin; i < end; ++i) {
+            this->evaluated[i] = false;
+        }
+        auto job = [this, &id, begin](uint w, uint b, uint e) {
+            if (this->config.batch && global_batch_supported) {
+                for (uint i = begin + b; i < begin + e && !(this->timer->isTimesUp((i - begin - b) / GLOBAL_BATCH_LANES)); i += GLOBAL_BATCH_LANES) {
+                    const uint n = min<uint>(GLOBAL_BATCH_LANES, begin + e - i);
+                    this->calculateScoreBatch<P>(id, i, n, this->workers[w]);
+                    for (uint j = i; j < i + n; ++j) {
+                        this->evaluated[j] = true;
+                    }
+                }
+                return;
+            }
+            for (uint i = begin + b; i < begin + e && !(this->timer->isTimesUp(i - begin - b)); ++i) {
+                this->evaluate<P>(id, i, this->workers[w]);
+                this->evaluated[i] = true;
+            }
+        };
+        if (this->pool == NULL) {
+            job(0, 0, end - begin);
+        } else {
+            this->pool->run(end - begin, GLOBAL_POOL_CHUNK, job);
+        }
+        // Merged in population order so the result does not depend on scheduling
+        for (uint i = begin; i < end; ++i) {
+            if (this->evaluated[i]) {
+                this->replace<P>(this->population.get(i));
+            }
+        }
     }
         
-    inline void evolveOnce(const int & id) {  
-        ++global_generation;                
+    // The genomes of rank i in the elites of each player
+    template <char P>
+    static inline FullGenome ranked(const Genome elites [GLOBAL_PLAYER_NUM][GLOBAL_MAX_ELITE_SIZE], char i) {
+        FullGenome res;
+        for (char k = 0; k < P; ++k) {
+            res.array[k] = elites[k][i];
+        }
+        return res;
+    }
+    inline void evolveOnce(const int & id) {
+        forPlayerNum(this->root->playerNum, [&](auto players) {
+            this->evolveOnceFor<decltype(players)::value>(id);
+        });
+    }
+    template <char P>
+    inline void evolveOnceFor(const int & id) {  
+        ++this->generation;                
+        // The elites of each player, matched by rank
+        Genome elites [GLOBAL_PLAYER_NUM][GLOBAL_MAX_ELITE_SIZE];
+        for (char k = 0; k < P; ++k) {
+            this->theTopGenomes[k].sorted(elites[k]);
+        }
+        this->breed<P>(id, elites);
+#ifdef BOMBERMAN_TELEMETRY
+        this->bestScores.push_back(this->theTopGenomes[id].top().score);
+#endif
+    }
+    // Scores a generation made of the elites, random genomes and children of the elites
+    template <char P>
+    inline void breed(const int & id, const Genome elites [GLOBAL_PLAYER_NUM][GLOBAL_MAX_ELITE_SIZE]) {
         uint i = 0;        
-        //insert previous generation best 
-        // this->theFullGenomes[i] = FullGenome(this->theTopGenomes[0].top(),this->theTopGenomes[1].top(),this->theTopGenomes[2].top(),this->theTopGenomes[3].top());
-        // ++i;
-        for (; i< 11; ++i) {
-            this->theFullGenomes[i] = FullGenome(this->theTopGenomes[0].array[i],this->theTopGenomes[1].array[i],this->theTopGenomes[2].array[i],this->theTopGenomes[3].array[i]);
+        for (; i< this->config.eliteSize; ++i) {
+            FullGenome elite = ranked<P>(elites, i);
+            this->applyOpponents(elite);
+            this->population.set(i, elite);
+            this->parents[i][0] = this->parents[i][1] = -1;
         }
         //May be add pure random gene
-		for (; i< GLOBAL_POPULATION_SIZE/2; ++i) {
-		    this->theFullGenomes[i] = FullGenome();            
+        const uint randomEnd = max<uint>(this->config.eliteSize, this->config.populationSize * this->config.randomShare);
+		for (; i< randomEnd; ++i) {
+		    this->population.set(i, this->randomFullGenome<P>());
+            this->parents[i][0] = this->parents[i][1] = -1;
         }
         //cross breed the remaining from best        
-        for (; i < GLOBAL_POPULATION_SIZE; ++i) {
-            int index_genome1 = int ((static_cast <float> (rand()) / static_cast <float> (RAND_MAX)) * (10)) ;
-            int index_genome2 = int ((static_cast <float> (rand()) / static_cast <float> (RAND_MAX)) * (10)) ;            
+        for (; i < this->config.populationSize; ++i) {
+            int index_genome1 = this->rng->below(this->config.eliteSize);
+            int index_genome2 = this->rng->below(this->config.eliteSize);            
             // We have a new genome with a new score                          
-            this->theFullGenomes[i].cross(this->theFullGenomes[index_genome1],this->theFullGenomes[index_genome2]);            
-            //this->theFullGenomes[i].mutate(this->theFullGenomes[0]);            
+            FullGenome child;
+            child.cross<P>(this->population.get(index_genome1), this->population.get(index_genome2), *this->rng,
+                           this->config.crossoverBias, this->config.mutationRate);
+            this->applyOpponents(child);
+            this->population.set(i, child);
+            this->parents[i][0] = index_genome1;
+            this->parents[i][1] = index_genome2;
         }   
                 
-        for (i=0; i < GLOBAL_POPULATION_SIZE && !(global_timer->isTimesUp()); ++i) {        
-            this->calculateScoreAndReplace(id, this->theFullGenomes[i]);
+        if (this->checkpoints.empty()) {
+            this->scorePopulation<P>(id, 0, this->config.populationSize);
+        } else {
+            // Parents first so that their checkpoints are ready for the children
+            for (RolloutCheckpoints& checkpoint : this->checkpoints) {
+                checkpoint.steps = 0;
+            }
+            this->scorePopulation<P>(id, 0, this->config.eliteSize);
+            this->scorePopulation<P>(id, this->config.eliteSize, this->config.populationSize);
+        }
+    }
+    // Share of distinct genomes of player id in the population
+    inline double diversity(const int& id) const {
+        vector<uint64_t> genes;
+        for (uint i = 0; i < this->config.populationSize; ++i) {
+            genes.push_back(this->population.genes[id][i]);
         }
+        sort(genes.begin(), genes.end());
+        return double(unique(genes.begin(), genes.end()) - genes.begin()) / this->config.populationSize;
     }
 
     inline void evolve(const int& id) {        
-        while(!(global_timer->isTimesUp())){
+        while(!(this->timer->isTimesUp()) && (this->maxGeneration == 0 || this->generation < this->maxGeneration)){
             this->evolveOnce(id);
         }
     }
     
-    inline FullGenome findBestFullGenome(const int& id) {          
-        FullGenome aFullgenome = FullGenome();
-        long int best_score=LONG_MIN;
-        char best = -1;
-        for(char i=0; i < 10;++i){                        
-            long int temp_score=0;
-            aFullgenome = FullGenome(theTopGenomes[0].array[i],theTopGenomes[1].array[i],theTopGenomes[2].array[i],theTopGenomes[3].array[i]);            
-            for(char j=0; j < 10;++j){
-                for(char k=0; k < GLOBAL_PLAYER_NUM;++k){
-                    if(k!=id){
-                        aFullgenome.update(k,theTopGenomes[k].array[j]);
+    inline FullGenome findBestFullGenome(const int& id) {
+        FullGenome res;
+        forPlayerNum(this->root->playerNum, [&](auto players) {
+            res = this->findBestFullGenomeFor<decltype(players)::value>(id);
+        });
+        return res;
+    }
+    template <char P>
+    inline FullGenome findBestFullGenomeFor(const int& id) {          
+        const uint candidates = min(this->config.eliteSize, GLOBAL_BEST_MATCHUPS);
+        long int scores[GLOBAL_BEST_MATCHUPS];
+        Genome elites [GLOBAL_PLAYER_NUM][GLOBAL_MAX_ELITE_SIZE];
+        for (char k = 0; k < P; ++k) {
+            this->theTopGenomes[k].sorted(elites[k]);
+        }
+        // Frozen opponents always play the same genome, one matchup is enough when all are
+        char matchups = 1;
+        for (char k = 0; k < P; ++k) {
+            if (k != id && !this->opponents.frozen[k]) {
+                matchups = candidates;
+            }
+        }
+        auto job = [this, &id, &scores, &elites, matchups](uint w, uint b, uint e) {
+            for(uint i=b; i < e;++i){                        
+                long int temp_score=0;
+                FullGenome aFullgenome = ranked<P>(elites, i);            
+                for(char j=0; j < matchups;++j){
+                    for(char k=0; k < P;++k){
+                        if(k!=id){
+                            aFullgenome.update(k,this->opponents.frozen[k] ? this->opponents.genome[k] : elites[k][j]);
+                        }
                     }
-                }
-                calculateScore(id, aFullgenome, *global_board); 
-                temp_score += aFullgenome.array[id].score;
-            }   
-            if(temp_score > best_score){
-                best_score = temp_score;
+                    calculateScore<P>(id, aFullgenome, *this->root, this->workers[w]); 
+                    temp_score += aFullgenome.array[id].score;
+                }   
+                scores[i] = temp_score;
+            }
+        };
+        if (this->pool == NULL) {
+            job(0, 0, candidates);
+        } else {
+            this->pool->run(candidates, 1, job);
+        }
+        long int best_score=LONG_MIN;
+        char best = 0;
+        for(char i=0; i < (char) candidates;++i){                        
+            if(scores[i] > best_score){
+                best_score = scores[i];
                 best = i;
             }
         }        
-        return FullGenome(theTopGenomes[0].array[best],theTopGenomes[1].array[best],theTopGenomes[2].array[best],theTopGenomes[3].array[best]);  
+        FullGenome res = ranked<P>(elites, best);
+        this->applyOpponents(res);
+        return res;
+    }
+};
+
+const char GLOBAL_ENGINE_GA = 0;
+const char GLOBAL_ENGINE_MCTS = 1;
+char global_engine = GLOBAL_ENGINE_GA;
+const char GLOBAL_MCTS_ACTIONS = 10; // 5 directions, without then with a bomb
+const uint GLOBAL_MCTS_NODES = 1 << 20;
+const float GLOBAL_MCTS_EXPLORATION = 1.0;
+
+// Kept at 16 bytes, the mean and 1/sqrt(visits) are updated on backpropagation so that selection has no division
+struct SmitsiNode {
+    int children = -1; // first of GLOBAL_MCTS_ACTIONS consecutive nodes, -1 until expanded
+    uint visits = 0;
+    float mean = 0; // of the normalized rewards
+    float invSqrtVisits = 0;
+
+    inline void add(float reward) {
+        ++this->visits;
+        this->mean += (reward - this->mean) / this->visits;
+        this->invSqrtVisits = 1 / sqrt(float(this->visits));
+    }
+};
+
+// Simultaneous move search: each player has its own tree over its own actions,
+// the players pick their action independently with UCT and share the rollout (Smitsimax)
+struct Smitsimax {
+    vector<SmitsiNode> nodes; // roots are nodes [0, GLOBAL_PLAYER_NUM)
+    uint used = 0;
+    const Board* root = NULL;
+    Timer* timer = NULL;
+    Rng* rng = NULL;
+    RolloutWorker worker;
+    float low [GLOBAL_PLAYER_NUM]; // range of the scores of the surviving players, for normalization
+    float high [GLOBAL_PLAYER_NUM];
+    uint compute = 0;
+    uint maxIterations = 0; // 0: until the timer runs out
+
+    inline Smitsimax() = default;
+    inline Smitsimax(Smitsimax const&) = default;
+    inline Smitsimax(Smitsimax&&) = default;
+    inline Smitsimax& operator=(Smitsimax const&) = default;
+    inline Smitsimax& operator=(Smitsimax&&) = default;
+
+    // The pool is allocated on the first turn and reused afterwards
+    inline void reset(const Board& root, Timer& timer, Rng& rng, const ScoreWeights& weights) {
+        if (this->nodes.empty()) {
+            this->nodes.resize(GLOBAL_MCTS_NODES);
+        }
+        for (char k = 0; k < GLOBAL_PLAYER_NUM; ++k) {
+            this->nodes[k] = SmitsiNode();
+            this->low[k] = INT_MAX;
+            this->high[k] = INT_MIN;
+        }
+        this->used = GLOBAL_PLAYER_NUM;
+        this->root = &root;
+        this->timer = &timer;
+        this->rng = &rng;
+        this->worker.scratch.weights = weights;
+        this->compute = 0;
+    }
+    static inline Gene action(char a) {
+        return Gene(char(a % 5), a >= 5);
+    }
+    // Child of node to play, expanding it when there is room; -1 when the pool is full
+    inline int select(int node) {
+        SmitsiNode& parent = this->nodes[node];
+        if (parent.children == -1) {
+            if (this->used + GLOBAL_MCTS_ACTIONS > this->nodes.size()) {
+                return -1;
+            }
+            parent.children = this->used;
+            for (char a = 0; a < GLOBAL_MCTS_ACTIONS; ++a) {
+                this->nodes[this->used++] = SmitsiNode();
+            }
+        }
+        // Untried actions first, from a random one
+        const char start = this->rng->below(GLOBAL_MCTS_ACTIONS);
+        for (char a = 0; a < GLOBAL_MCTS_ACTIONS; ++a) {
+            const int child = parent.children + (start + a) % GLOBAL_MCTS_ACTIONS;
+            if (this->nodes[child].visits == 0) {
+                return child;
+            }
+        }
+        const float exploration = GLOBAL_MCTS_EXPLORATION * sqrt(log(float(parent.visits)));
+        int best = parent.children;
+        float bestValue = -1;
+        for (char a = 0; a < GLOBAL_MCTS_ACTIONS; ++a) {
+            const SmitsiNode& child = this->nodes[parent.children + a];
+            const float value = child.mean + exploration * child.invSqrtVisits;
+            if (value > bestValue) {
+                bestValue = value;
+                best = parent.children + a;
+            }
+        }
+        return best;
+    }
+    // Dead players get 0, the surviving ones are spread over [0.1, 1]
+    inline float reward(char k, int score) {
+        if (score == INT_MIN) {
+            return 0;
+        }
+        this->low[k] = min(this->low[k], float(score));
+        this->high[k] = max(this->high[k], float(score));
+        if (this->high[k] <= this->low[k]) {
+            return 0.55;
+        }
+        return 0.1 + 0.9 * (score - this->low[k]) / (this->high[k] - this->low[k]);
+    }
+    // Descend every tree until one of them reaches a new node, then play random genes
+    inline void iterate(const int& id) {
+        Board& board = this->worker.board;
+        board = *this->root;
+        board.journal = NULL;
+        int path [GLOBAL_PLAYER_NUM][GLOBAL_GENOME_SIZE + 1];
+        char length [GLOBAL_PLAYER_NUM];
+        for (char k = 0; k < GLOBAL_PLAYER_NUM; ++k) {
+            path[k][0] = k;
+            length[k] = 1;
+        }
+        bool inTree = true;
+        for (char i = 0; i < GLOBAL_GENOME_SIZE; ++i) {
+            Gene gArray[GLOBAL_PLAYER_NUM];
+            bool leaf = false;
+            for (char k = 0; k < GLOBAL_PLAYER_NUM; ++k) {
+                if (!board.players[k].isAlive) {
+                    continue;
+                }
+                const int child = inTree ? this->select(path[k][length[k] - 1]) : -1;
+                if (child == -1) {
+                    gArray[k] = Gene(*this->rng);
+                    continue;
+                }
+                gArray[k] = Smitsimax::action(child - this->nodes[path[k][length[k] - 1]].children);
+                leaf |= this->nodes[child].visits == 0;
+                path[k][length[k]++] = child;
+            }
+            inTree &= !leaf;
+            board.update(gArray, GLOBAL_GENOME_SIZE-i, this->worker.scratch);
+            ++this->worker.steps;
+            if (board.scores[id] == INT_MIN) {
+                break;
+            }
+        }
+        for (char k = 0; k < board.playerNum; ++k) {
+            const float r = this->reward(k, board.scores[k]);
+            for (char j = 0; j < length[k]; ++j) {
+                this->nodes[path[k][j]].add(r);
+            }
+        }
+        ++this->compute;
+    }
+    inline void search(const int& id) {
+        while (!(this->timer->isTimesUp(this->compute)) && (this->maxIterations == 0 || this->compute < this->maxIterations)) {
+            this->iterate(id);
+        }
+    }
+    // Most visited line of every tree, genes past the explored depth stay still
+    inline FullGenome bestFullGenome() const {
+        FullGenome res;
+        for (char k = 0; k < GLOBAL_PLAYER_NUM; ++k) {
+            res.array[k].genes = 0;
+            int node = k;
+            for (char i = 0; i < GLOBAL_GENOME_SIZE && this->nodes[node].children != -1; ++i) {
+                int best = this->nodes[node].children;
+                for (char a = 1; a < GLOBAL_MCTS_ACTIONS; ++a) {
+                    if (this->nodes[this->nodes[node].children + a].visits > this->nodes[best].visits) {
+                        best = this->nodes[node].children + a;
+                    }
+                }
+                if (this->nodes[best].visits == 0) {
+                    break;
+                }
+                res.array[k].setGene(i, Smitsimax::action(best - this->nodes[node].children));
+                node = best;
+            }
+        }
+        return res;
+    }
+};
+
+#ifdef BOMBERMAN_TELEMETRY
+// One JSON line per turn, to stderr or the file given by --telemetry=<path>
+ostream* global_telemetry = &cerr;
+ofstream global_telemetry_file;
+
+struct TurnTelemetry {
+    chrono::time_point<chrono::steady_clock> mark;
+    int turn = 0;
+    double parseMs = 0; // first input line to the start of the search
+    double initMs = 0; // random batches scored before the first generation
+    double evolveMs = 0;
+    double bestMs = 0; // findBestFullGenome
+    double totalMs = 0; // first input line to the answer
+    double margin = 0;
+    uint rollouts = 0;
+    uint generations = 0;
+    double diversity = 0;
+    vector<int> bestScores;
+    string action;
+
+    // Milliseconds since the previous call
+    inline double lap() {
+        const chrono::time_point<chrono::steady_clock> now = chrono::steady_clock::now();
+        const double res = chrono::duration<double, milli>(now - this->mark).count();
+        this->mark = now;
+        return res;
+    }
+    inline void write(ostream& out) const {
+        out << "{\"turn\":" << this->turn << ",\"parse_ms\":" << this->parseMs << ",\"init_ms\":" << this->initMs
+            << ",\"evolve_ms\":" << this->evolveMs << ",\"best_ms\":" << this->bestMs << ",\"total_ms\":" << this->totalMs
+            << ",\"margin_ms\":" << this->margin << ",\"rollouts\":" << this->rollouts << ",\"generations\":" << this->generations
+            << ",\"diversity\":" << this->diversity << ",\"best_scores\":[";
+        for (size_t i = 0; i < this->bestScores.size(); ++i) {
+            out << (i ? "," : "") << this->bestScores[i];
+        }
+        out << "],\"action\":\"" << this->action << "\"}" << endl;
+    }
+};
+#endif
+
+// Binary replay: a ReplayHeader then one ReplayTurn per turn played, each followed by the
+// game input of that turn. Records are appended with a single write() so that the bots
+// of parallel games can share one file, and are read back with mmap by replay_tool.
+const char GLOBAL_REPLAY_MAGIC [8] = {'B', 'M', 'R', 'E', 'P', 'L', 'A', 'Y'};
+const uint32_t GLOBAL_REPLAY_VERSION = 5;
+const uint32_t GLOBAL_REPLAY_MCTS = 1 << 4;
+const uint32_t GLOBAL_REPLAY_OPPONENT_MODEL = 1 << 5;
+const uint32_t GLOBAL_REPLAY_PERSIST = 1 << 6;
+const uint32_t GLOBAL_REPLAY_DETERMINISTIC = 1 << 7;
+const int GLOBAL_REPLAY_HEADER_TRIES = 100; // milliseconds waited for the header of a new file
+
+struct ReplayHeader {
+    char magic [8];
+    uint32_t version;
+    uint32_t turnSize; // sizeof(ReplayTurn): Board and FullGenome are stored as laid out by this build
+};
+
+struct ReplayTurn {
+    uint32_t size = 0; // of the record and its input, a multiple of 8
+    uint32_t inputSize = 0;
+    uint64_t game = 0;
+    uint64_t seed = 0; // the search of the turn is seeded from seed and turn
+    int32_t turn = 0;
+    int32_t myId = 0;
+    uint32_t options = 0; // GLOBAL_REPLAY_* of the bot, the simulation modes are in config
+    uint32_t compute = 0;
+    uint32_t generation = 0;
+    uint32_t ttProbes = 0;
+    uint32_t ttHits = 0;
+    uint32_t frozenOpponents = 0;
+    float margin = 0; // milliseconds
+    float elapsed = 0; // first input line to the answer, milliseconds
+    char action [24] = {};
+    SearchConfig config;
+    FullGenome previousBest; // the search starts from it
+    Board board; // parsed input, as searched
+
+    inline const char* input() const {
+        return (const char*) (this + 1);
+    }
+};
+static_assert(is_trivially_copyable<ReplayTurn>::value, "replay turns are written and mapped as raw bytes");
+static_assert(sizeof(ReplayTurn) % 8 == 0, "records stay 8 byte aligned in the file");
+
+struct ReplayWriter {
+    int fd = -1;
+
+    inline ReplayWriter() = default;
+    inline ReplayWriter(ReplayWriter const&) = delete;
+    inline ReplayWriter& operator=(ReplayWriter const&) = delete;
+    inline ~ReplayWriter() {
+        if (this->fd >= 0) {
+            close(this->fd);
+        }
+    }
+
+    static inline ReplayHeader header() {
+        ReplayHeader res;
+        memcpy(res.magic, GLOBAL_REPLAY_MAGIC, sizeof(res.magic));
+        res.version = GLOBAL_REPLAY_VERSION;
+        res.turnSize = sizeof(ReplayTurn);
+        return res;
+    }
+    // Appends to path. Only the process that creates the file writes the header,
+    // the others wait for it and check that it matches this build.
+    inline bool open(const string& path) {
+        const ReplayHeader expected = header();
+        this->fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_APPEND, 0644);
+        if (this->fd >= 0) {
+            return ::write(this->fd, &expected, sizeof(expected)) == sizeof(expected);
+        }
+        if (errno != EEXIST) {
+            return false;
+        }
+        this->fd = ::open(path.c_str(), O_RDWR | O_APPEND);
+        if (this->fd < 0) {
+            return false;
+        }
+        ReplayHeader found;
+        for (int tries = 0; tries < GLOBAL_REPLAY_HEADER_TRIES; ++tries) {
+            if (pread(this->fd, &found, sizeof(found), 0) == sizeof(found)) {
+                if (memcmp(&found, &expected, sizeof(found)) != 0) {
+                    cerr << path << " was written by another build" << endl;
+                    return false;
+                }
+                return true;
+            }
+            usleep(1000); // created by another process that has not written the header yet
+        }
+        cerr << path << " has no replay header" << endl;
+        return false;
+    }
+    inline void write(ReplayTurn& turn, const string& input) const {
+        turn.inputSize = input.size();
+        turn.size = (sizeof(ReplayTurn) + input.size() + 7) & ~7;
+        vector<char> record(turn.size, 0);
+        memcpy(record.data(), &turn, sizeof(ReplayTurn));
+        memcpy(record.data() + sizeof(ReplayTurn), input.data(), input.size());
+        if (::write(this->fd, record.data(), record.size()) != (ssize_t) record.size()) {
+            cerr << "replay: short write" << endl;
+        }
     }
 };
 
+ReplayWriter* global_replay = NULL;
+
 string output(const int& id, const Gene& g, const Board& b){
     string res = "";
-    if (g.bomb) {
+    if (g.bomb()) {
         res += "BOMB";
     } else {
         res += "MOVE";
@@ -1132,60 +3655,426 @@ string output(const int& id, const Gene& g, const Board& b){
 }
 
 string output2(const int& id, FullGenome& g, const Board& b){   
-    global_working_board = b;
+    Board next = b;
+    SimScratch scratch;
     Gene gArray[GLOBAL_PLAYER_NUM];        
     g.genes(0, gArray);        
-    global_working_board.update(gArray, GLOBAL_GENOME_SIZE);  
+    next.update(gArray, GLOBAL_GENOME_SIZE, scratch);  
     string res = "";
-    if (g.array[id].array[0].bomb) {
+    if (g.array[id].gene(0).bomb()) {
         res += "BOMB";
     } else {
         res += "MOVE";
     }
     res += " ";
-    res += global_working_board.players[id].p.toString();
+    res += next.players[id].p.toString();
     return res;
 }
 
 
+// One player's state across turns, fed with the CodinGame protocol lines
+struct Bot {
+    int myId;
+    int turn = 1;
+    int turnTime = GLOBAL_TURN_TIME; // whole turns, the clock keeps its margin
+    int firstTurnTime = GLOBAL_TURN_TIME_MAX_FIRST_TURN;
+    TimeManager clock;
+    ThreadPool* pool;
+    Board theBoard;
+    Board previous_board;
+    FullGenome bestFullGenomes;
+    uint compute = 0;
+    uint generation = 0;
+    uint ttProbes = 0;
+    uint ttHits = 0;
+    // The search of each turn only depends on seed and turn; deterministic
+    // bots replace the clock with a fixed number of generations
+    uint64_t seed = 1;
+    bool deterministic = false;
+    uint deterministicGenerations = GLOBAL_MAX_GENERATION_NUM;
+    Rng rng;
+    char engine = global_engine;
+    Smitsimax mcts;
+    bool modelOpponents = global_use_opponent_model;
+    OpponentModel opponents;
+    uint frozenOpponents = 0;
+    bool persistPopulation = global_use_population_store; // warm-start each turn from the elites of the previous one
+    Evolution evolution;
+    SearchConfig config = global_config;
+#ifdef BOMBERMAN_TELEMETRY
+    TurnTelemetry telemetry;
+#endif
+    ReplayWriter* replay = global_replay;
+    uint64_t game = 0; // groups the turns of a game in the replay
+    ReplayTurn record;
+    string inputRows; // game input of the current turn, kept for the replay
+    string inputEntities;
+    int inputEntityNum = 0;
+
+    inline Bot(int myId, ThreadPool* pool = NULL) : myId(myId), pool(pool) {}
+
+    inline void beginTurn() {
+        this->previous_board = this->theBoard;
+        SimScratch scratch;
+        this->theBoard.bigBadaboum(scratch);
+    }
+    inline void readRow(int y, const char* row) {
+        if (y == 0) {
+            this->clock.startTurn();
+            this->inputRows.clear();
+        }
+        this->theBoard.init(y, row);
+        if (this->replay != NULL) {
+            this->inputRows.append(row, GLOBAL_MAX_WIDTH);
+            this->inputRows += '\n';
+        }
+    }
+    inline void beginEntities() {
+        this->theBoard.clearBombs();
+        for (int i = 0; i < GLOBAL_PLAYER_NUM; i++) {
+            this->theBoard.scores[i]=0;
+        }
+        this->inputEntities.clear();
+        this->inputEntityNum = 0;
+    }
+    inline void readEntity(int entityType, int owner, int x, int y, int param1, int param2) {
+        this->theBoard.init(entityType, owner, x, y, param1, param2, this->previous_board, this->turn);
+        if (this->replay != NULL) {
+            ++this->inputEntityNum;
+            this->inputEntities += to_string(entityType) + " " + to_string(owner) + " " + to_string(x) + " " + to_string(y) + " "
+                           + to_string(param1) + " " + to_string(param2) + "\n";
+        }
+    }
+    inline uint32_t replayOptions() const {
+        return (this->engine == GLOBAL_ENGINE_MCTS ? GLOBAL_REPLAY_MCTS : 0) | (this->modelOpponents ? GLOBAL_REPLAY_OPPONENT_MODEL : 0)
+               | (this->persistPopulation ? GLOBAL_REPLAY_PERSIST : 0) | (this->deterministic ? GLOBAL_REPLAY_DETERMINISTIC : 0);
+    }
+    inline string play() {
+        if (this->turn == 1) {
+            this->theBoard.countPlayers();
+        }
+        if (this->replay != NULL) {
+            this->record.board = this->theBoard;
+            this->record.board.journal = NULL;
+            this->record.previousBest = this->bestFullGenomes;
+            this->record.config = this->config;
+        }
+        Timer timer = this->deterministic ? Timer(INT_MAX) : this->clock.timer(this->turn == 1 ? this->firstTurnTime : this->turnTime);
+        this->rng.seed(this->seed * 0x9E3779B97F4A7C15ULL + this->turn);
+#ifdef BOMBERMAN_TELEMETRY
+        this->telemetry = TurnTelemetry();
+        this->telemetry.turn = this->turn;
+        this->telemetry.mark = this->clock.start;
+        this->telemetry.parseMs = this->telemetry.lap();
+#endif
+        if (this->engine == GLOBAL_ENGINE_MCTS) {
+            this->mcts.reset(this->theBoard, timer, this->rng, this->config.weights);
+            // as many rollouts as the deterministic generations of the GA would score
+            this->mcts.maxIterations = this->deterministic ? this->deterministicGenerations * this->config.populationSize : 0;
+            this->mcts.search(this->myId);
+#ifdef BOMBERMAN_TELEMETRY
+            this->telemetry.evolveMs = this->telemetry.lap();
+#endif
+            this->bestFullGenomes = this->mcts.bestFullGenome();
+            this->compute = this->mcts.compute;
+            this->generation = 0;
+            return this->endTurn(timer);
+        }
+        //this->theBoard.toString();
+        this->bestFullGenomes.nextGen(this->rng);
+        OpponentPlan plan;
+        if (this->modelOpponents) {
+            this->opponents.observe(this->previous_board, this->theBoard, this->myId);
+            this->opponents.predict(this->theBoard, this->bestFullGenomes);
+            plan = this->opponents.plan(this->myId);
+        }
+        this->frozenOpponents = 0;
+        for (char k = 0; k < GLOBAL_PLAYER_NUM; ++k) {
+            this->frozenOpponents += plan.frozen[k];
+        }
+        Evolution& evol = this->evolution;
+        evol.reset(this->myId, this->config.populationSize*4, this->bestFullGenomes, this->theBoard, timer, this->rng, this->pool, plan, this->config,
+                   this->persistPopulation);
+        if (this->deterministic) {
+            evol.maxGeneration = this->deterministicGenerations;
+        }
+#ifdef BOMBERMAN_TELEMETRY
+        this->telemetry.initMs = this->telemetry.lap();
+#endif
+        evol.evolve(this->myId);
+#ifdef BOMBERMAN_TELEMETRY
+        this->telemetry.evolveMs = this->telemetry.lap();
+#endif
+        this->bestFullGenomes = evol.findBestFullGenome(this->myId);
+#ifdef BOMBERMAN_TELEMETRY
+        this->telemetry.bestMs = this->telemetry.lap();
+        this->telemetry.bestScores = evol.bestScores;
+        this->telemetry.diversity = evol.diversity(this->myId);
+#endif
+        this->compute = evol.compute;
+        this->generation = evol.generation;
+        uint ttStores;
+        evol.ttStats(this->ttProbes, this->ttHits, ttStores);
+        // for(int i =0;i<4;++i){
+        //     bestFullGenomes.update(i, evol.theTopGenomes[i].top()); 
+        // }                
+        //cerr << bestFullGenomes.array[myId].toString() << endl;
+        return this->endTurn(timer);
+    }
+    inline string endTurn(const Timer& timer) {
+        ++this->turn;
+        string res = output2(this->myId, this->bestFullGenomes, this->theBoard);
+        this->clock.endTurn(timer);
+        if (this->replay != NULL) {
+            ReplayTurn& r = this->record;
+            r.game = this->game;
+            r.seed = this->seed;
+            r.turn = this->turn - 1;
+            r.myId = this->myId;
+            r.options = this->replayOptions();
+            r.compute = this->compute;
+            r.generation = this->generation;
+            r.ttProbes = this->ttProbes;
+            r.ttHits = this->ttHits;
+            r.frozenOpponents = this->frozenOpponents;
+            r.margin = this->clock.margin;
+            r.elapsed = chrono::duration<float, milli>(chrono::steady_clock::now() - this->clock.start).count();
+            memset(r.action, 0, sizeof(r.action));
+            memcpy(r.action, res.data(), min(res.size(), sizeof(r.action) - 1));
+        }
+#ifdef BOMBERMAN_TELEMETRY
+        this->telemetry.totalMs = chrono::duration<double, milli>(chrono::steady_clock::now() - this->clock.start).count();
+        this->telemetry.margin = this->clock.margin;
+        this->telemetry.rollouts = this->compute;
+        this->telemetry.generations = this->generation;
+        this->telemetry.action = res;
+#endif
+        return res;
+    }
+    // Once the answer is out: writing the record must not delay it, nor count in the margin
+    inline void finishTurn() {
+        if (this->replay != NULL) {
+            this->replay->write(this->record, this->inputRows + to_string(this->inputEntityNum) + "\n" + this->inputEntities);
+        }
+#ifdef BOMBERMAN_TELEMETRY
+        this->telemetry.write(*global_telemetry);
+#endif
+    }
+};
+
+const int GLOBAL_INPUT_BUFFER = 1 << 16;
+
+// Game input straight from a file descriptor: read() fills a fixed buffer and rows and
+// numbers are parsed in place. A refill only takes what the pipe already holds, so
+// reading a turn never waits for the next one.
+struct InputReader {
+    int fd;
+    char buffer [GLOBAL_INPUT_BUFFER];
+    int begin = 0; // next unread byte
+    int end = 0;
+
+    inline InputReader(int fd = 0) : fd(fd) {}
+    inline InputReader(InputReader const&) = delete;
+    inline InputReader& operator=(InputReader const&) = delete;
+
+    // Moves the unread bytes to the front and reads more, false on end of input
+    inline bool fill() {
+        if (this->begin > 0) {
+            memmove(this->buffer, this->buffer + this->begin, this->end - this->begin);
+            this->end -= this->begin;
+            this->begin = 0;
+        }
+        while (this->end < GLOBAL_INPUT_BUFFER) {
+            const ssize_t n = read(this->fd, this->buffer + this->end, GLOBAL_INPUT_BUFFER - this->end);
+            if (n > 0) {
+                this->end += n;
+                return true;
+            }
+            if (n == 0 || errno != EINTR) {
+                return false;
+            }
+        }
+        return false;
+    }
+    inline bool skipSpaces() {
+        while (true) {
+            while (this->begin < this->end && (unsigned char) this->buffer[this->begin] <= ' ') {
+                ++this->begin;
+            }
+            if (this->begin < this->end) {
+                return true;
+            }
+            if (!this->fill()) {
+                return false;
+            }
+        }
+    }
+    inline bool readInt(int& n) {
+        if (!this->skipSpaces()) {
+            return false;
+        }
+        bool negative = false;
+        if (this->buffer[this->begin] == '-') {
+            negative = true;
+            ++this->begin;
+        }
+        n = 0;
+        bool digits = false;
+        while (true) {
+            while (this->begin < this->end && this->buffer[this->begin] >= '0' && this->buffer[this->begin] <= '9') {
+                n = n * 10 + (this->buffer[this->begin++] - '0');
+                digits = true;
+            }
+            // A number cut by the end of a read goes on in the next one
+            if (this->begin < this->end || !this->fill()) {
+                break;
+            }
+        }
+        if (negative) {
+            n = -n;
+        }
+        return digits;
+    }
+    // Next non-empty line, valid until the next call; false on end of input or a row shorter than width
+    inline bool readRow(const char*& row, int width) {
+        if (!this->skipSpaces()) {
+            return false;
+        }
+        int scanned = this->begin;
+        while (true) {
+            const char* newline = (const char*) memchr(this->buffer + scanned, '\n', this->end - scanned);
+            if (newline != NULL) {
+                scanned = newline - this->buffer;
+                break;
+            }
+            scanned = this->end;
+            const int offset = this->begin;
+            const bool more = this->fill();
+            scanned -= offset;
+            if (!more) {
+                break; // last line without a newline
+            }
+        }
+        row = this->buffer + this->begin;
+        const int length = scanned - this->begin;
+        this->begin = min(scanned + 1, this->end);
+        return length >= width;
+    }
+};
+
+#ifndef BOMBERMAN_LIBRARY
 /**
  * Auto-generated code below aims at helping you parse
  * the standard input according to the problem statement.
  **/
-int main()
+int main(int argc, char** argv)
 {
-    bool first_turn = false;
+    uint64_t seed = 1;
+    bool deterministic = false;
+    uint deterministicGenerations = GLOBAL_MAX_GENERATION_NUM;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--bitboard") {
+            global_config.bitboard = true;
+        } else if (arg == "--undo") {
+            global_config.undo = true;
+        } else if (arg == "--checkpoints") {
+            global_config.checkpoints = true;
+        } else if (arg == "--danger") {
+            global_config.dangerMap = true;
+        } else if (arg == "--batch") {
+            global_config.batch = true;
+        } else if (arg.compare(0, 9, "--config=") == 0) {
+            if (!global_config.load(arg.substr(9))) {
+                return 1;
+            }
+        } else if (arg == "--print-config") {
+            cout << global_config.toString();
+            return 0;
+        } else if (arg.compare(0, 8, "--depth=") == 0) {
+            if (!global_config.set("depth", arg.substr(8))) {
+                cerr << "Cannot read " << arg << endl;
+                return 1;
+            }
+        } else if (arg == "--leaf") {
+            global_config.leaf = GLOBAL_LEAF_DISTANCE;
+        } else if (arg == "--tt") {
+            global_config.ttBits = 16;
+        } else if (arg.compare(0, 5, "--tt=") == 0) {
+            if (!global_config.set("ttBits", arg.substr(5))) {
+                cerr << "Cannot read " << arg << endl;
+                return 1;
+            }
+        } else if (arg == "--engine=mcts") {
+            global_engine = GLOBAL_ENGINE_MCTS;
+        } else if (arg == "--engine=ga") {
+            global_engine = GLOBAL_ENGINE_GA;
+        } else if (arg == "--opponent-model") {
+            global_use_opponent_model = true;
+        } else if (arg == "--persist") {
+            global_use_population_store = true;
+        } else if (arg.compare(0, 9, "--replay=") == 0) {
+            global_replay = new ReplayWriter();
+            if (!global_replay->open(arg.substr(9))) {
+                cerr << "Cannot open replay " << arg.substr(9) << endl;
+                return 1;
+            }
+#ifdef BOMBERMAN_TELEMETRY
+        } else if (arg.compare(0, 12, "--telemetry=") == 0) {
+            global_telemetry_file.open(arg.substr(12));
+            if (!global_telemetry_file) {
+                cerr << "Cannot open telemetry " << arg.substr(12) << endl;
+                return 1;
+            }
+            global_telemetry = &global_telemetry_file;
+#endif
+        } else if (arg.compare(0, 10, "--threads=") == 0) {
+            global_thread_num = max(1, atoi(arg.c_str() + 10));
+        } else if (arg.compare(0, 7, "--seed=") == 0) {
+            seed = strtoull(arg.c_str() + 7, NULL, 10);
+        } else if (arg == "--deterministic") {
+            deterministic = true;
+        } else if (arg.compare(0, 16, "--deterministic=") == 0) {
+            deterministic = true;
+            deterministicGenerations = atoi(arg.c_str() + 16);
+        }
+    }
     int width;
     int height;
-    double score_cumul = 0;
     int myId;
-    cin >> width >> height >> myId; cin.ignore();
-    Board theBoard = Board();
-    global_board = &theBoard;
-    Board previous_board;
+    InputReader input(0);
+    if (!input.readInt(width) || !input.readInt(height) || !input.readInt(myId)) {
+        return 0;
+    }
+    // Board, BitMask and the blast rays are laid out for the league map at compile time
+    if (width != GLOBAL_MAX_WIDTH || height != GLOBAL_MAX_HEIGHT) {
+        cerr << "Map is " << width << "x" << height << ", the bot is built for " << to_string(GLOBAL_MAX_WIDTH) << "x" << to_string(GLOBAL_MAX_HEIGHT) << endl;
+        return 1;
+    }
+    ThreadPool* pool = global_thread_num > 1 ? new ThreadPool(global_thread_num) : NULL;
+    Bot bot(myId, pool);
+    bot.seed = seed;
+    bot.deterministic = deterministic;
+    bot.deterministicGenerations = deterministicGenerations;
+    bot.game = uint64_t(chrono::system_clock::now().time_since_epoch().count()) ^ uint64_t(getpid()) << 48;
     // game loop
-    FullGenome bestFullGenomes;
     while (1)
     {
         global_debug=false;
-        global_debug=true;
-        global_compute = 0;
-        global_generation = 0;
-        previous_board = theBoard;
-        myQueue<Square*> deleteBox;
-        global_board->bigBadaboum(deleteBox);
+        bot.beginTurn();
         for (int i = 0; i < height; i++)
         {
-            string row;
-            getline(cin, row);
-            global_board->init(i,row);
+            const char* row;
+            if (!input.readRow(row, width)) {
+                return 0;
+            }
+            bot.readRow(i,row);
         }
         int entities;
-        cin >> entities; cin.ignore();
-        global_board->clearBombs();
-        for (int i = 0; i < GLOBAL_PLAYER_NUM; i++) {
-            global_board->scores[i]=0;
+        if (!input.readInt(entities)) {
+            return 0;
         }
+        bot.beginEntities();
         for (int i = 0; i < entities; i++) {
             int entityType;
             int owner;
@@ -1193,36 +4082,15 @@ int main()
             int y;
             int param1;
             int param2;
-            cin >> entityType >> owner >> x >> y >> param1 >> param2; cin.ignore();            
-            global_board->init(entityType, owner, x, y, param1, param2, previous_board);
+            if (!input.readInt(entityType) || !input.readInt(owner) || !input.readInt(x) || !input.readInt(y)
+                || !input.readInt(param1) || !input.readInt(param2)) {
+                return 0;
+            }
+            bot.readEntity(entityType, owner, x, y, param1, param2);
         }               
 
-        global_debug=false;
-        Timer timer = Timer(first_turn);
-        global_timer = &timer;
-        //global_board->toString();
-        global_debug=false;               
-        bestFullGenomes.nextGen();
-        Evolution evol(myId, GLOBAL_POPULATION_SIZE*4, bestFullGenomes );                    
-        evol.evolve(myId);
-        bestFullGenomes = evol.findBestFullGenome(myId);
-        // for(int i =0;i<4;++i){
-        //     bestFullGenomes.update(i, evol.theTopGenomes[i].top()); 
-        // }                
-        const Genome& myBestGenome = bestFullGenomes.array[myId];
-        global_debug=true;
-        
-        Board tmp_board = *global_board;    
-                   
-        //cerr << bestFullGenomes.array[myId].toString() << endl;
-        
-        evol.calculateScore(myId, bestFullGenomes, tmp_board);        
-
-        global_debug=false;
-            
-        cout << output2(myId, bestFullGenomes, *global_board) << endl;
-        score_cumul += global_compute;
-          
-        ++global_turn;
+        cout << bot.play() << endl;
+        bot.finishTurn();
     }
-}
\ No newline at end of file
+}
+#endif
@@ -0,0 +1,140 @@
+// Batch self-play: g++ -std=c++17 -O2 -pthread referee.cpp -o referee
+// ./referee --games=1000 --players=4 --threads=8 --turn-ms=5 --seed=1
+// --engine=ga|mcts picks the search of every bot, --engine0= overrides it for player 0,
+// as --opponent-model0, --persist0, --depth0= and --leaf0 do for --opponent-model, --persist,
+// --depth=<rollout steps> and --leaf (evaluation of the state a shortened rollout stops at),
+// --config=<profile> sets the search parameters of every bot and --config0= those of player 0,
+// --replay=<path> appends every turn of every bot to a binary replay (see replay_tool.cpp)
+#include "referee.h"
+
+int main(int argc, char** argv)
+{
+    int games = 100;
+    int players = 4;
+    int turnTime = GLOBAL_TURN_TIME_MAX;
+    uint seed = 1;
+    uint threads = thread::hardware_concurrency();
+    int engine0 = -1;
+    bool opponentModel0 = false;
+    bool persist0 = false;
+    string config0;
+    string depth0;
+    bool leaf0 = false;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg.compare(0, 8, "--games=") == 0) {
+            games = atoi(arg.c_str() + 8);
+        } else if (arg.compare(0, 10, "--players=") == 0) {
+            players = min<int>(GLOBAL_PLAYER_NUM, max(1, atoi(arg.c_str() + 10)));
+        } else if (arg.compare(0, 10, "--turn-ms=") == 0) {
+            turnTime = atoi(arg.c_str() + 10);
+        } else if (arg.compare(0, 7, "--seed=") == 0) {
+            seed = atoi(arg.c_str() + 7);
+        } else if (arg.compare(0, 10, "--threads=") == 0) {
+            threads = atoi(arg.c_str() + 10);
+        } else if (arg == "--bitboard") {
+            global_config.bitboard = true;
+        } else if (arg == "--undo") {
+            global_config.undo = true;
+        } else if (arg == "--checkpoints") {
+            global_config.checkpoints = true;
+        } else if (arg == "--danger") {
+            global_config.dangerMap = true;
+        } else if (arg == "--batch") {
+            global_config.batch = true;
+        } else if (arg.compare(0, 9, "--config=") == 0) {
+            if (!global_config.load(arg.substr(9))) {
+                return 1;
+            }
+        } else if (arg.compare(0, 10, "--config0=") == 0) {
+            config0 = arg.substr(10);
+        } else if (arg.compare(0, 8, "--depth=") == 0) {
+            if (!global_config.set("depth", arg.substr(8))) {
+                cerr << "Cannot read " << arg << endl;
+                return 1;
+            }
+        } else if (arg == "--leaf") {
+            global_config.leaf = GLOBAL_LEAF_DISTANCE;
+        } else if (arg.compare(0, 9, "--depth0=") == 0) {
+            depth0 = arg.substr(9);
+        } else if (arg == "--leaf0") {
+            leaf0 = true;
+        } else if (arg == "--engine=mcts") {
+            global_engine = GLOBAL_ENGINE_MCTS;
+        } else if (arg == "--engine=ga") {
+            global_engine = GLOBAL_ENGINE_GA;
+        } else if (arg == "--engine0=mcts") {
+            engine0 = GLOBAL_ENGINE_MCTS;
+        } else if (arg == "--engine0=ga") {
+            engine0 = GLOBAL_ENGINE_GA;
+        } else if (arg == "--opponent-model") {
+            global_use_opponent_model = true;
+        } else if (arg == "--opponent-model0") {
+            opponentModel0 = true;
+        } else if (arg == "--persist") {
+            global_use_population_store = true;
+        } else if (arg == "--persist0") {
+            persist0 = true;
+        } else if (arg.compare(0, 9, "--replay=") == 0) {
+            global_replay = new ReplayWriter();
+            if (!global_replay->open(arg.substr(9))) {
+                cerr << "Cannot open replay " << arg.substr(9) << endl;
+                return 1;
+            }
+        } else if (arg == "--tt") {
+            global_config.ttBits = 16;
+        } else if (arg.compare(0, 5, "--tt=") == 0) {
+            if (!global_config.set("ttBits", arg.substr(5))) {
+                cerr << "Cannot read " << arg << endl;
+                return 1;
+            }
+        }
+    }
+    // Player 0 starts from the profile of the others, whatever the order of the flags
+    bool custom0 = !config0.empty() || !depth0.empty() || leaf0;
+    SearchConfig profile0 = global_config;
+    if (!config0.empty() && !profile0.load(config0)) {
+        return 1;
+    }
+    if (!depth0.empty() && !profile0.set("depth", depth0)) {
+        cerr << "Cannot read --depth0=" << depth0 << endl;
+        return 1;
+    }
+    if (leaf0) {
+        profile0.leaf = GLOBAL_LEAF_DISTANCE;
+    }
+    ThreadPool* pool = threads > 1 ? new ThreadPool(threads) : NULL;
+    chrono::time_point<chrono::steady_clock> start = chrono::steady_clock::now();
+    BotSetup setup;
+    if (engine0 != -1 || opponentModel0 || persist0 || custom0) {
+        setup = [engine0, opponentModel0, persist0, profile0, custom0](int i, Bot& bot) {
+            if (i == 0 && engine0 != -1) {
+                bot.engine = engine0;
+            }
+            if (i == 0 && opponentModel0) {
+                bot.modelOpponents = true;
+            }
+            if (i == 0 && persist0) {
+                bot.persistPopulation = true;
+            }
+            if (i == 0 && custom0) {
+                bot.config = profile0;
+            }
+        };
+    }
+    MatchStats stats = playMatches(games, players, seed, turnTime, pool, setup);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << "games " << stats.games << " in " << seconds << " s (" << stats.games * 3600 / seconds << " games/h)"
+         << ", average length " << stats.length / stats.games << " turns" << endl;
+    for (int i = 0; i < players; ++i) {
+        cout << "player " << i
+             << " win rate " << stats.wins[i] / stats.games
+             << " average score " << stats.score[i] / stats.games
+             << " rollouts/turn " << stats.compute[i] / max(1.0, stats.turns[i])
+             << " generations/turn " << stats.generation[i] / max(1.0, stats.turns[i])
+             << " frozen opponents/turn " << stats.frozen[i] / max(1.0, stats.turns[i]) << endl;
+    }
+    delete pool;
+    delete global_replay;
+}
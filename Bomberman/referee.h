@@ -0,0 +1,411 @@
+#ifndef BOMBERMAN_REFEREE_H
+#define BOMBERMAN_REFEREE_H
+
+// Local Hypersonic referee: plays Bot instances against each other in-process.
+#define BOMBERMAN_LIBRARY
+#include "bomberman.cpp"
+
+#include <random>
+#include <sstream>
+
+const int GLOBAL_REFEREE_MAX_TURNS = 200;
+const int GLOBAL_REFEREE_TURNS_AFTER_LAST_BOX = 20;
+const char GLOBAL_REFEREE_BOMB_TIMER = 8;
+
+struct RefereePlayer {
+    Point p;
+    char bombs = 1;
+    char range = 3;
+    int score = 0;
+    int deathTurn = INT_MAX;
+    bool isAlive = false;
+};
+
+// Full game rules, the board is only used to store squares and bombs
+struct Referee {
+    Board board;
+    RefereePlayer players [GLOBAL_PLAYER_NUM];
+    int playerNum;
+    int turn = 0;
+    int lastBoxTurn = -1;
+
+    inline Referee(int playerNum, uint seed, float boxDensity = 0.45) : playerNum(playerNum) {
+        mt19937 rng(seed);
+        uniform_real_distribution<float> proba(0, 1);
+        const Point spawns[4] = {Point(0, 0), Point(GLOBAL_MAX_WIDTH-1, GLOBAL_MAX_HEIGHT-1),
+                                 Point(GLOBAL_MAX_WIDTH-1, 0), Point(0, GLOBAL_MAX_HEIGHT-1)};
+        this->board.clearBombs();
+        // Boxes are drawn in the top left quarter and mirrored, spawns and their neighbours stay free
+        for (char x = 0; x <= GLOBAL_MAX_WIDTH/2; ++x) {
+            for (char y = 0; y <= GLOBAL_MAX_HEIGHT/2; ++y) {
+                Square square;
+                if (x % 2 == 1 && y % 2 == 1) {
+                    square.addWall();
+                } else if (x + y > 1 && proba(rng) < boxDensity) {
+                    float content = proba(rng);
+                    square.addBox(content < 0.5 ? '0' : (content < 0.75 ? '1' : '2'));
+                }
+                const char xs[2] = {x, char(GLOBAL_MAX_WIDTH-1-x)};
+                const char ys[2] = {y, char(GLOBAL_MAX_HEIGHT-1-y)};
+                for (char i = 0; i < 2; ++i) {
+                    for (char j = 0; j < 2; ++j) {
+                        this->board.theBoard[xs[i]][ys[j]].t = square.t;
+                    }
+                }
+            }
+        }
+        for (int i = 0; i < playerNum; ++i) {
+            this->players[i].p = spawns[i];
+            this->players[i].isAlive = true;
+        }
+    }
+
+    inline string row(int y) const {
+        string res(GLOBAL_MAX_WIDTH, '.');
+        for (char x = 0; x < GLOBAL_MAX_WIDTH; ++x) {
+            switch (this->board.theBoard[x][y].t) {
+                case Square::type::wall: res[x] = 'X'; break;
+                case Square::type::box: res[x] = '0'; break;
+                case Square::type::box_b_range: res[x] = '1'; break;
+                case Square::type::box_b_stock: res[x] = '2'; break;
+                default: break;
+            }
+        }
+        return res;
+    }
+    // entityType owner x y param1 param2, as in the game input
+    inline vector<array<int, 6> > entities() const {
+        vector<array<int, 6> > res;
+        for (int i = 0; i < this->playerNum; ++i) {
+            const RefereePlayer& player = this->players[i];
+            if (player.isAlive) {
+                res.push_back({0, i, player.p.x, player.p.y, player.bombs, player.range});
+            }
+        }
+        for (char i = 0; i < this->board.bombNum; ++i) {
+            const Bomb& bomb = this->board.bombs[i];
+            const Point p = bomb.point();
+            res.push_back({1, bomb.owner, p.x, p.y, bomb.timer, bomb.range});
+        }
+        for (char x = 0; x < GLOBAL_MAX_WIDTH; ++x) {
+            for (char y = 0; y < GLOBAL_MAX_HEIGHT; ++y) {
+                if (this->board.theBoard[x][y].t == Square::type::item_b_range) {
+                    res.push_back({2, 0, x, y, 1, 0});
+                } else if (this->board.theBoard[x][y].t == Square::type::item_b_stock) {
+                    res.push_back({2, 0, x, y, 2, 0});
+                }
+            }
+        }
+        return res;
+    }
+    inline int aliveNum() const {
+        int res = 0;
+        for (int i = 0; i < this->playerNum; ++i) {
+            res += this->players[i].isAlive;
+        }
+        return res;
+    }
+    inline int boxNum() const {
+        int res = 0;
+        for (char x = 0; x < GLOBAL_MAX_WIDTH; ++x) {
+            for (char y = 0; y < GLOBAL_MAX_HEIGHT; ++y) {
+                res += this->board.theBoard[x][y].isBox();
+            }
+        }
+        return res;
+    }
+    inline bool isOver() const {
+        if (this->turn >= GLOBAL_REFEREE_MAX_TURNS || this->aliveNum() <= (this->playerNum > 1 ? 1 : 0)) {
+            return true;
+        }
+        return this->lastBoxTurn >= 0 && this->turn >= this->lastBoxTurn + GLOBAL_REFEREE_TURNS_AFTER_LAST_BOX;
+    }
+
+    // Bombs tick, then every bomb at 0 goes off with its chain reactions at once
+    inline void explode() {
+        bool exploding[GLOBAL_MAX_BOMBS] = {false};
+        unsigned char owners[GLOBAL_MAX_WIDTH*GLOBAL_MAX_HEIGHT] = {0}; // players credited per box
+        bool blast[GLOBAL_MAX_WIDTH*GLOBAL_MAX_HEIGHT] = {false};
+        myQueue<char> explosionList;
+        for (char i = 0; i < this->board.bombNum; ++i) {
+            this->board.bombs[i].tick();
+            if (this->board.bombs[i].isExploding()) {
+                exploding[i] = true;
+                explosionList.push(i);
+            }
+        }
+        const Square* squares = &(this->board.theBoard[0][0]);
+        while (!explosionList.empty()) {
+            const Bomb& bomb = this->board.bombs[explosionList.front_and_pop()];
+            const int origin = bomb.cell;
+            blast[origin] = true;
+            for (char d = 0; d < 4; ++d) {
+                const char length = min<char>(bomb.range - 1, GLOBAL_BLAST_RAYS.length[origin][d]);
+                for (char k = 0; k < length; ++k) {
+                    const int cell = GLOBAL_BLAST_RAYS.cells[origin][d][k];
+                    const Square& square = squares[cell];
+                    if (square.t == Square::type::wall) {
+                        break;
+                    }
+                    blast[cell] = true;
+                    if (square.isBox()) {
+                        owners[cell] |= 1 << bomb.owner;
+                        break;
+                    }
+                    if (square.containsBomb()) {
+                        char hit = this->board.bombAt(cell);
+                        if (hit != -1 && !exploding[hit]) {
+                            exploding[hit] = true;
+                            explosionList.push(hit);
+                        }
+                        break;
+                    }
+                    if (square.hasBonus()) {
+                        break;
+                    }
+                }
+            }
+        }
+        for (int i = 0; i < this->playerNum; ++i) {
+            if (this->players[i].isAlive && blast[GLOBAL_BLAST_RAYS.index(this->players[i].p)]) {
+                this->players[i].isAlive = false;
+                this->players[i].deathTurn = this->turn;
+            }
+        }
+        // From the last slot, the ones below keep their index
+        for (char i = this->board.bombNum - 1; i >= 0; --i) {
+            if (exploding[i]) {
+                ++this->players[this->board.bombs[i].owner].bombs;
+                this->board.remove_bomb(i);
+            }
+        }
+        Square* cells = &(this->board.theBoard[0][0]);
+        for (int cell = 0; cell < GLOBAL_MAX_WIDTH*GLOBAL_MAX_HEIGHT; ++cell) {
+            if (!blast[cell]) {
+                continue;
+            }
+            Square& square = cells[cell];
+            for (int i = 0; i < this->playerNum; ++i) {
+                this->players[i].score += (owners[cell] >> i) & 1;
+            }
+            if (square.t == Square::type::box_b_range) {
+                square.t = Square::type::item_b_range;
+            } else if (square.t == Square::type::box_b_stock) {
+                square.t = Square::type::item_b_stock;
+            } else {
+                square.t = Square::type::empty;
+            }
+        }
+    }
+    inline bool isFree(const Point& p) const {
+        return p.isInside() && this->board.theBoard[p.x][p.y].canEnter();
+    }
+    // Next square on a shortest path to the target, or the current one if out of reach
+    inline Point stepTowards(const Point& from, const Point& target) const {
+        if (from == target || !this->isFree(target)) {
+            return from;
+        }
+        const char dx[4] = {0, 1, 0, -1};
+        const char dy[4] = {-1, 0, 1, 0};
+        int distance[GLOBAL_MAX_WIDTH*GLOBAL_MAX_HEIGHT];
+        fill(distance, distance + GLOBAL_MAX_WIDTH*GLOBAL_MAX_HEIGHT, INT_MAX);
+        myQueue<Point> queue;
+        distance[GLOBAL_BLAST_RAYS.index(target)] = 0;
+        queue.push(target);
+        while (!queue.empty()) {
+            Point cur = queue.front_and_pop();
+            for (char d = 0; d < 4; ++d) {
+                Point next(cur.x + dx[d], cur.y + dy[d]);
+                if (next == from) {
+                    return cur;
+                }
+                if (this->isFree(next) && distance[GLOBAL_BLAST_RAYS.index(next)] == INT_MAX) {
+                    distance[GLOBAL_BLAST_RAYS.index(next)] = distance[GLOBAL_BLAST_RAYS.index(cur)] + 1;
+                    queue.push(next);
+                }
+            }
+        }
+        return from;
+    }
+    // One turn: explosions, then bombs are dropped, then everybody moves and picks up items
+    inline void step(const string actions[GLOBAL_PLAYER_NUM]) {
+        ++this->turn;
+        this->explode();
+        Point targets [GLOBAL_PLAYER_NUM];
+        bool dropBomb [GLOBAL_PLAYER_NUM] = {false};
+        for (int i = 0; i < this->playerNum; ++i) {
+            targets[i] = this->players[i].p;
+            if (!this->players[i].isAlive) {
+                continue;
+            }
+            istringstream in(actions[i]);
+            string command;
+            int x, y;
+            if (in >> command >> x >> y) {
+                targets[i] = Point(x, y);
+                dropBomb[i] = command == "BOMB";
+            }
+        }
+        for (int i = 0; i < this->playerNum; ++i) {
+            RefereePlayer& player = this->players[i];
+            if (dropBomb[i] && player.bombs > 0 && this->board.bombAt(cellIndex(player.p)) == -1) {
+                --player.bombs;
+                this->board.push_bomb(i, player.range, GLOBAL_REFEREE_BOMB_TIMER, player.p);
+                this->board.theBoard[player.p.x][player.p.y].addBomb();
+            }
+        }
+        Point moves [GLOBAL_PLAYER_NUM];
+        for (int i = 0; i < this->playerNum; ++i) {
+            if (this->players[i].isAlive) {
+                moves[i] = this->stepTowards(this->players[i].p, targets[i]);
+            }
+        }
+        for (int i = 0; i < this->playerNum; ++i) {
+            if (this->players[i].isAlive) {
+                this->players[i].p = moves[i];
+                const Square& square = this->board.theBoard[moves[i].x][moves[i].y];
+                if (square.t == Square::type::item_b_range) {
+                    ++this->players[i].range;
+                } else if (square.t == Square::type::item_b_stock) {
+                    ++this->players[i].bombs;
+                }
+            }
+        }
+        for (int i = 0; i < this->playerNum; ++i) {
+            if (this->players[i].isAlive) {
+                this->board.theBoard[moves[i].x][moves[i].y].removeBonus();
+            }
+        }
+        if (this->lastBoxTurn < 0 && this->boxNum() == 0) {
+            this->lastBoxTurn = this->turn;
+        }
+    }
+    // 1 for the winner(s), players that died later or destroyed more boxes rank first
+    inline void ranking(int rank[GLOBAL_PLAYER_NUM]) const {
+        for (int i = 0; i < this->playerNum; ++i) {
+            rank[i] = 1;
+            for (int j = 0; j < this->playerNum; ++j) {
+                const RefereePlayer& a = this->players[i];
+                const RefereePlayer& b = this->players[j];
+                if (b.deathTurn > a.deathTurn || (b.deathTurn == a.deathTurn && b.score > a.score)) {
+                    ++rank[i];
+                }
+            }
+        }
+    }
+};
+
+struct MatchResult {
+    int rank [GLOBAL_PLAYER_NUM];
+    int score [GLOBAL_PLAYER_NUM];
+    int turns [GLOBAL_PLAYER_NUM]; // turns played by each bot
+    unsigned long compute [GLOBAL_PLAYER_NUM];
+    unsigned long generation [GLOBAL_PLAYER_NUM];
+    unsigned long frozen [GLOBAL_PLAYER_NUM]; // opponents played by the opponent model, summed over turns
+    int length;
+};
+
+// Called on every bot before the game starts, to configure the seat
+typedef function<void(int, Bot&)> BotSetup;
+
+inline MatchResult playMatch(int playerNum, uint seed, int turnTime, const BotSetup& setup = BotSetup()) {
+    Referee referee(playerNum, seed);
+    vector<Bot> bots;
+    for (int i = 0; i < playerNum; ++i) {
+        bots.emplace_back(i);
+        // turnTime is the search budget, nothing is spent on I/O here
+        bots.back().turnTime = turnTime;
+        bots.back().firstTurnTime = turnTime;
+        bots.back().clock.margin = 0;
+        bots.back().clock.calibrate = false;
+        bots.back().seed = uint64_t(seed) * GLOBAL_PLAYER_NUM + i;
+        bots.back().game = seed;
+        if (setup) {
+            setup(i, bots.back());
+        }
+    }
+    MatchResult result = MatchResult();
+    string actions [GLOBAL_PLAYER_NUM];
+    while (!referee.isOver()) {
+        vector<array<int, 6> > entities = referee.entities();
+        for (int i = 0; i < playerNum; ++i) {
+            if (!referee.players[i].isAlive) {
+                continue;
+            }
+            Bot& bot = bots[i];
+            bot.beginTurn();
+            for (int y = 0; y < GLOBAL_MAX_HEIGHT; ++y) {
+                bot.readRow(y, referee.row(y).c_str());
+            }
+            bot.beginEntities();
+            for (const array<int, 6>& e : entities) {
+                bot.readEntity(e[0], e[1], e[2], e[3], e[4], e[5]);
+            }
+            actions[i] = bot.play();
+            bot.finishTurn();
+            ++result.turns[i];
+            result.compute[i] += bot.compute;
+            result.generation[i] += bot.generation;
+            result.frozen[i] += bot.frozenOpponents;
+        }
+        referee.step(actions);
+    }
+    referee.ranking(result.rank);
+    for (int i = 0; i < playerNum; ++i) {
+        result.score[i] = referee.players[i].score;
+    }
+    result.length = referee.turn;
+    return result;
+}
+
+struct MatchStats {
+    int games = 0;
+    double wins [GLOBAL_PLAYER_NUM] = {0};
+    double score [GLOBAL_PLAYER_NUM] = {0};
+    double turns [GLOBAL_PLAYER_NUM] = {0};
+    double compute [GLOBAL_PLAYER_NUM] = {0};
+    double generation [GLOBAL_PLAYER_NUM] = {0};
+    double frozen [GLOBAL_PLAYER_NUM] = {0};
+    double length = 0;
+
+    inline void add(const MatchResult& r, int playerNum) {
+        ++this->games;
+        int winners = 0;
+        for (int i = 0; i < playerNum; ++i) {
+            winners += r.rank[i] == 1;
+        }
+        for (int i = 0; i < playerNum; ++i) {
+            if (r.rank[i] == 1) {
+                this->wins[i] += 1.0 / winners;
+            }
+            this->score[i] += r.score[i];
+            this->turns[i] += r.turns[i];
+            this->compute[i] += r.compute[i];
+            this->generation[i] += r.generation[i];
+            this->frozen[i] += r.frozen[i];
+        }
+        this->length += r.length;
+    }
+};
+
+// Plays games on every worker of the pool, game g uses map seed+g
+inline MatchStats playMatches(int games, int playerNum, uint seed, int turnTime, ThreadPool* pool, const BotSetup& setup = BotSetup()) {
+    vector<MatchResult> results(games);
+    auto job = [&](uint, uint b, uint e) {
+        for (uint g = b; g < e; ++g) {
+            results[g] = playMatch(playerNum, seed + g, turnTime, setup);
+        }
+    };
+    if (pool == NULL) {
+        job(0, 0, games);
+    } else {
+        pool->run(games, 1, job);
+    }
+    MatchStats stats;
+    for (const MatchResult& r : results) {
+        stats.add(r, playerNum);
+    }
+    return stats;
+}
+
+#endif
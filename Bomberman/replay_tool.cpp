@@ -0,0 +1,174 @@
+// Binary replays written by --replay=<path>: g++ -std=c++17 -O2 -pthread replay_tool.cpp -o replay_tool
+// ./replay_tool <path>                 games, turns and search statistics
+// ./replay_tool <path> --list          one line per turn: index game turn id generations rollouts ms action
+// ./replay_tool <path> --input=<n>     the game input of turn n
+// ./replay_tool <path> --rerun=<n> [--generations=<g>]
+//                                      searches turn n again from its board, genome and seed, for the
+//                                      recorded generations (rollouts for mcts) unless g is given
+#define BOMBERMAN_LIBRARY
+#include "bomberman.cpp"
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// The whole file mapped read-only, turns point into the mapping
+struct ReplayFile {
+    const char* data = NULL;
+    size_t length = 0;
+    vector<const ReplayTurn*> turns;
+    bool truncated = false; // the last record is incomplete, e.g. the game is still running
+
+    inline ReplayFile() = default;
+    inline ReplayFile(ReplayFile const&) = delete;
+    inline ReplayFile& operator=(ReplayFile const&) = delete;
+    inline ~ReplayFile() {
+        if (this->data != NULL) {
+            munmap((void*) this->data, this->length);
+        }
+    }
+
+    inline bool open(const string& path) {
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            cerr << "Cannot open " << path << endl;
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(ReplayHeader)) {
+            cerr << path << " is not a replay" << endl;
+            close(fd);
+            return false;
+        }
+        this->length = st.st_size;
+        void* map = mmap(NULL, this->length, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (map == MAP_FAILED) {
+            cerr << "Cannot map " << path << endl;
+            return false;
+        }
+        this->data = (const char*) map;
+        madvise(map, this->length, MADV_SEQUENTIAL);
+        const ReplayHeader& header = *(const ReplayHeader*) this->data;
+        if (memcmp(header.magic, GLOBAL_REPLAY_MAGIC, sizeof(header.magic)) != 0) {
+            cerr << path << " is not a replay" << endl;
+            return false;
+        }
+        if (header.version != GLOBAL_REPLAY_VERSION || header.turnSize != sizeof(ReplayTurn)) {
+            cerr << path << " was written by another build (version " << header.version << ", " << header.turnSize
+                 << " byte turns, expected " << GLOBAL_REPLAY_VERSION << ", " << sizeof(ReplayTurn) << ")" << endl;
+            return false;
+        }
+        size_t offset = sizeof(ReplayHeader);
+        while (offset < this->length) {
+            const ReplayTurn* turn = (const ReplayTurn*) (this->data + offset);
+            if (this->length - offset < sizeof(ReplayTurn) || turn->size < sizeof(ReplayTurn) + turn->inputSize
+                || turn->size > this->length - offset) {
+                this->truncated = true;
+                break;
+            }
+            this->turns.push_back(turn);
+            offset += turn->size;
+        }
+        return true;
+    }
+};
+
+inline void printTurn(size_t index, const ReplayTurn& turn) {
+    cout << index << " " << turn.game << " " << turn.turn << " " << turn.myId << " " << turn.generation << " " << turn.compute
+         << " " << turn.elapsed << " " << turn.action << endl;
+}
+
+inline void summary(const ReplayFile& replay) {
+    set<uint64_t> games;
+    double generations = 0;
+    double rollouts = 0;
+    double elapsed = 0;
+    float maxElapsed = 0;
+    for (const ReplayTurn* turn : replay.turns) {
+        games.insert(turn->game);
+        generations += turn->generation;
+        rollouts += turn->compute;
+        elapsed += turn->elapsed;
+        maxElapsed = max(maxElapsed, turn->elapsed);
+    }
+    const double n = max<size_t>(1, replay.turns.size());
+    cout << "games " << games.size() << " turns " << replay.turns.size() << (replay.truncated ? " (last record truncated)" : "") << endl;
+    cout << "generations/turn " << generations / n << " rollouts/turn " << rollouts / n
+         << " ms/turn " << elapsed / n << " max ms " << maxElapsed << endl;
+}
+
+// Same search as Bot::play on the recorded turn, with a fixed budget instead of the clock
+inline string rerun(const ReplayTurn& turn, int generations) {
+    Bot bot(turn.myId);
+    bot.replay = NULL;
+    bot.theBoard = turn.board;
+    bot.previous_board = turn.board;
+    bot.bestFullGenomes = turn.previousBest;
+    bot.turn = turn.turn;
+    bot.seed = turn.seed;
+    bot.engine = turn.options & GLOBAL_REPLAY_MCTS ? GLOBAL_ENGINE_MCTS : GLOBAL_ENGINE_GA;
+    bot.config = turn.config;
+    // Their state is carried from the previous turns, which the record does not hold
+    bot.modelOpponents = false;
+    bot.persistPopulation = false;
+    bot.deterministic = true;
+    // 0 would search until the clock runs out, and there is none here
+    if (generations > 0) {
+        bot.deterministicGenerations = generations;
+    } else if (bot.engine == GLOBAL_ENGINE_MCTS) {
+        bot.deterministicGenerations = max<uint>(1, (turn.compute + turn.config.populationSize - 1) / turn.config.populationSize);
+    } else {
+        bot.deterministicGenerations = max<uint>(1, turn.generation);
+    }
+    const string res = bot.play();
+    cout << "rerun " << bot.generation << " generations " << bot.compute << " rollouts: " << res
+         << (res == turn.action ? " (same as recorded)" : " (recorded " + string(turn.action) + ")") << endl;
+    if (turn.options & (GLOBAL_REPLAY_OPPONENT_MODEL | GLOBAL_REPLAY_PERSIST)) {
+        cout << "recorded with the opponent model or a persistent population, rerun without them" << endl;
+    }
+    return res;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        cerr << "usage: " << argv[0] << " <replay> [--list | --input=<n> | --rerun=<n> [--generations=<g>]]" << endl;
+        return 1;
+    }
+    bool list = false;
+    long input = -1;
+    long rerunIndex = -1;
+    int generations = 0;
+    for (int i = 2; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--list") {
+            list = true;
+        } else if (arg.compare(0, 8, "--input=") == 0) {
+            input = atol(arg.c_str() + 8);
+        } else if (arg.compare(0, 8, "--rerun=") == 0) {
+            rerunIndex = atol(arg.c_str() + 8);
+        } else if (arg.compare(0, 14, "--generations=") == 0) {
+            generations = atoi(arg.c_str() + 14);
+        }
+    }
+    ReplayFile replay;
+    if (!replay.open(argv[1])) {
+        return 1;
+    }
+    const long selected = max(input, rerunIndex);
+    if (selected >= (long) replay.turns.size()) {
+        cerr << "turn " << selected << " out of " << replay.turns.size() << endl;
+        return 1;
+    }
+    if (list) {
+        for (size_t i = 0; i < replay.turns.size(); ++i) {
+            printTurn(i, *replay.turns[i]);
+        }
+    } else if (input >= 0) {
+        cout.write(replay.turns[input]->input(), replay.turns[input]->inputSize);
+    } else if (rerunIndex >= 0) {
+        printTurn(rerunIndex, *replay.turns[rerunIndex]);
+        rerun(*replay.turns[rerunIndex], generations);
+    } else {
+        summary(replay);
+    }
+}
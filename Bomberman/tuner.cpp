@@ -0,0 +1,142 @@
+// Search parameter tuner: g++ -std=c++17 -O2 -pthread tuner.cpp -o tuner
+// ./tuner --games=40 --iterations=30 --turn-ms=20 --threads=8 --seed=1 [--config=<base>] [--out=<profile>]
+// Hill climbing from the base profile, one parameter at a time: a candidate plays 2-player games
+// against the incumbent, in both seats, and replaces it when it wins more than --accept of them.
+// A parameter whose both directions are rejected has its step halved.
+#include "referee.h"
+
+struct TunedParameter {
+    const char* name;
+    double step;
+    double min;
+    double max;
+};
+
+const TunedParameter GLOBAL_TUNED_PARAMETERS[] = {
+    {"populationSize", 200, 100, GLOBAL_POPULATION_SIZE},
+    {"eliteSize", 4, 2, 40},
+    {"randomShare", 0.1, 0, 0.9},
+    {"crossoverBias", 0.1, 0, 1},
+    {"mutationRate", 0.05, 0, 0.5},
+    {"depth", 2, 4, GLOBAL_GENOME_SIZE},
+    {"weights.box", 1, 0, 20},
+    {"weights.rangeItem", 1, 0, 20},
+    {"weights.stockItem", 1, 0, 20},
+    {"weights.stockCap", 2, 0, 40},
+    {"weights.bomb", 1, -10, 10},
+    {"weights.stay", 1, -10, 10},
+    {"weights.leafSpotBox", 1, 0, 20},
+    {"weights.leafSpotStep", 1, 0, 10},
+    {"weights.leafItemStep", 1, 0, 10},
+    {"weights.leafEscapeStep", 1, 0, 10},
+    {"weights.leafTrapped", 50, -1000, 0},
+};
+const int GLOBAL_TUNED_PARAMETER_NUM = sizeof(GLOBAL_TUNED_PARAMETERS) / sizeof(TunedParameter);
+
+// The value of a parameter, integral tells whether steps below 1 are meaningless
+inline double parameter(const SearchConfig& config, const string& name, bool& integral) {
+    double res = 0;
+    SearchConfig::fields(config, [&](const char* n, const auto& field, double, double) {
+        if (name == n) {
+            res = field;
+            integral = is_integral<typename remove_reference<decltype(field)>::type>::value;
+        }
+    });
+    return res;
+}
+
+// Win rate of the candidate, over games in each seat
+inline double challenge(const SearchConfig& candidate, const SearchConfig& incumbent, int games, uint seed, int turnTime, ThreadPool* pool) {
+    double wins = 0;
+    for (int seat = 0; seat < 2; ++seat) {
+        MatchStats stats = playMatches(games, 2, seed, turnTime, pool, [&](int i, Bot& bot) {
+            bot.config = i == seat ? candidate : incumbent;
+        });
+        wins += stats.wins[seat];
+    }
+    return wins / (2 * games);
+}
+
+int main(int argc, char** argv)
+{
+    int games = 40;
+    int iterations = 30;
+    int turnTime = 20;
+    uint seed = 1;
+    uint threads = thread::hardware_concurrency();
+    double accept = 0.55;
+    string out;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg.compare(0, 8, "--games=") == 0) {
+            games = max(1, atoi(arg.c_str() + 8));
+        } else if (arg.compare(0, 13, "--iterations=") == 0) {
+            iterations = atoi(arg.c_str() + 13);
+        } else if (arg.compare(0, 10, "--turn-ms=") == 0) {
+            turnTime = atoi(arg.c_str() + 10);
+        } else if (arg.compare(0, 7, "--seed=") == 0) {
+            seed = atoi(arg.c_str() + 7);
+        } else if (arg.compare(0, 10, "--threads=") == 0) {
+            threads = atoi(arg.c_str() + 10);
+        } else if (arg.compare(0, 9, "--accept=") == 0) {
+            accept = atof(arg.c_str() + 9);
+        } else if (arg.compare(0, 9, "--config=") == 0) {
+            if (!global_config.load(arg.substr(9))) {
+                return 1;
+            }
+        } else if (arg.compare(0, 6, "--out=") == 0) {
+            out = arg.substr(6);
+        } else if (arg == "--bitboard") {
+            global_config.bitboard = true;
+        } else if (arg == "--batch") {
+            global_config.batch = true;
+        }
+    }
+    ThreadPool* pool = threads > 1 ? new ThreadPool(threads) : NULL;
+    SearchConfig best = global_config;
+    double steps [GLOBAL_TUNED_PARAMETER_NUM];
+    for (int p = 0; p < GLOBAL_TUNED_PARAMETER_NUM; ++p) {
+        steps[p] = GLOBAL_TUNED_PARAMETERS[p].step;
+    }
+    int p = 0;
+    for (int it = 0; it < iterations; ++it, p = (p + 1) % GLOBAL_TUNED_PARAMETER_NUM) {
+        const TunedParameter& tuned = GLOBAL_TUNED_PARAMETERS[p];
+        bool integral = false;
+        const double value = parameter(best, tuned.name, integral);
+        if (integral && steps[p] < 1) {
+            continue;
+        }
+        // Fresh maps on every iteration, the profile should not fit a few seeds
+        const uint iterationSeed = seed + uint(it) * 2 * games;
+        bool accepted = false;
+        for (int direction = 1; direction >= -1 && !accepted; direction -= 2) {
+            const double next = min(tuned.max, max(tuned.min, value + direction * steps[p]));
+            if (next == value) {
+                continue;
+            }
+            SearchConfig candidate = best;
+            candidate.set(tuned.name, to_string(next));
+            const double rate = challenge(candidate, best, games, iterationSeed, turnTime, pool);
+            cout << "iteration " << it << " " << tuned.name << " " << value << " -> " << next
+                 << " win rate " << rate << (rate > accept ? " accepted" : "") << endl;
+            if (rate > accept) {
+                best = candidate;
+                accepted = true;
+            }
+        }
+        if (!accepted) {
+            steps[p] /= 2;
+        }
+    }
+    cout << best.toString();
+    if (!out.empty()) {
+        ofstream file(out);
+        file << best.toString();
+        if (!file) {
+            cerr << "Cannot write " << out << endl;
+            delete pool;
+            return 1;
+        }
+    }
+    delete pool;
+}